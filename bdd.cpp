@@ -0,0 +1,300 @@
+#include "bdd.hpp"
+#include "logic_builder.hpp"
+#include "logic_node.hpp"
+#include "traversal.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <unordered_map>
+
+Bdd_Manager::Bdd_Manager(unsigned cache_bits)
+    : computed(size_t(1) << cache_bits, Cache_Entry{UINT32_MAX, 0, 0, 0}) {
+  for (BddId terminal : {false_id, true_id}) {
+    levels.push_back(terminal_level);
+    lows.push_back(terminal);
+    highs.push_back(terminal);
+  }
+  rebuild_unique_table(64);
+}
+
+void Bdd_Manager::set_order(const std::vector<int> &variables) {
+  assert(size() == 2 && variable_at_level.empty());
+  for (int variable : variables) {
+    level_of(variable);
+  }
+}
+
+uint32_t Bdd_Manager::level_of(int variable) {
+  assert(variable > 0);
+  const size_t index = variable - 1;
+  if (index >= level_of_variable.size()) {
+    level_of_variable.resize(index + 1, terminal_level);
+  }
+  if (level_of_variable[index] == terminal_level) {
+    level_of_variable[index] = variable_at_level.size();
+    variable_at_level.push_back(variable);
+  }
+  return level_of_variable[index];
+}
+
+std::vector<int>
+Bdd_Manager::variable_order(const std::vector<std::shared_ptr<Formula>> &formulas,
+                            Bdd_Ordering ordering) {
+  std::vector<int> order;
+  std::vector<size_t> references;
+  for (const auto &f : formulas) {
+    for_each_node(*f, Visit_Order::PRE_ORDER, [&](const Formula &n) {
+      const Variable *variable = as_variable(n);
+      if (!variable)
+        return;
+      const size_t index = std::abs(variable->getLiteral()) - 1;
+      if (index >= references.size())
+        references.resize(index + 1, 0);
+      if (!references[index]++)
+        order.push_back(index + 1);
+    });
+  }
+  switch (ordering) {
+  case Bdd_Ordering::NATURAL:
+    std::sort(order.begin(), order.end());
+    break;
+  case Bdd_Ordering::FIRST_OCCURRENCE:
+    break;
+  case Bdd_Ordering::FREQUENCY:
+    std::stable_sort(order.begin(), order.end(), [&references](int a, int b) {
+      return references[a - 1] > references[b - 1];
+    });
+    break;
+  }
+  return order;
+}
+
+size_t Bdd_Manager::node_hash(uint32_t level, BddId low, BddId high) const {
+  uint64_t h = level;
+  h = h * 0x9e3779b97f4a7c15ull + low;
+  h = h * 0x9e3779b97f4a7c15ull + high;
+  return h ^ (h >> 29);
+}
+
+void Bdd_Manager::insert_unique(BddId id) {
+  const size_t mask = unique_table.size() - 1;
+  size_t pos = node_hash(levels[id], lows[id], highs[id]) & mask;
+  while (unique_table[pos]) {
+    pos = (pos + 1) & mask;
+  }
+  unique_table[pos] = id + 1;
+  ++unique_entries;
+}
+
+void Bdd_Manager::rebuild_unique_table(size_t slots) {
+  unique_table.assign(slots, 0);
+  unique_entries = 0;
+  for (BddId id = true_id + 1; id < levels.size(); ++id) {
+    if (levels[id] != dead_level) {
+      insert_unique(id);
+    }
+  }
+}
+
+BddId Bdd_Manager::make_node(uint32_t level, BddId low, BddId high) {
+  if (low == high) {
+    return low; // reduction: the test is redundant
+  }
+  const size_t mask = unique_table.size() - 1;
+  for (size_t pos = node_hash(level, low, high) & mask; unique_table[pos];
+       pos = (pos + 1) & mask) {
+    const BddId id = unique_table[pos] - 1;
+    if (levels[id] == level && lows[id] == low && highs[id] == high) {
+      return id;
+    }
+  }
+  // keep the load factor below one half
+  if (2 * (unique_entries + 1) > unique_table.size()) {
+    rebuild_unique_table(2 * unique_table.size());
+  }
+  BddId id;
+  if (!free_ids.empty()) {
+    id = free_ids.back();
+    free_ids.pop_back();
+    levels[id] = level;
+    lows[id] = low;
+    highs[id] = high;
+  } else {
+    assert(levels.size() < UINT32_MAX);
+    id = levels.size();
+    levels.push_back(level);
+    lows.push_back(low);
+    highs.push_back(high);
+  }
+  insert_unique(id);
+  return id;
+}
+
+BddId Bdd_Manager::make_variable(int literal) {
+  assert(literal != 0);
+  const uint32_t level = level_of(std::abs(literal));
+  return literal > 0 ? make_node(level, false_id, true_id)
+                     : make_node(level, true_id, false_id);
+}
+
+BddId Bdd_Manager::cofactor(BddId f, uint32_t level, bool value) const {
+  if (levels[f] != level) {
+    return f; // f does not depend on the variable at `level`
+  }
+  return value ? highs[f] : lows[f];
+}
+
+BddId Bdd_Manager::ite(BddId f, BddId g, BddId h) {
+  // terminal cases
+  if (f == true_id || g == h) {
+    return g;
+  }
+  if (f == false_id) {
+    return h;
+  }
+  if (g == true_id && h == false_id) {
+    return f;
+  }
+
+  Cache_Entry &entry =
+      computed[node_hash(f, g, h) & (computed.size() - 1)];
+  if (entry.f == f && entry.g == g && entry.h == h) {
+    return entry.result;
+  }
+
+  const uint32_t top = std::min({levels[f], levels[g], levels[h]});
+  const BddId low = ite(cofactor(f, top, false), cofactor(g, top, false),
+                        cofactor(h, top, false));
+  const BddId high = ite(cofactor(f, top, true), cofactor(g, top, true),
+                         cofactor(h, top, true));
+  const BddId result = make_node(top, low, high);
+  entry = {f, g, h, result};
+  return result;
+}
+
+BddId Bdd_Manager::from_formula(const Formula &f) {
+  std::unordered_map<uint64_t, BddId> converted;
+  for_each_node(f, Visit_Order::POST_ORDER, [&](const Formula &n) {
+    BddId result = false_id; // every kind assigns it
+    switch (n.getKind()) {
+    case Node_Kind::CONSTANT:
+      result = static_cast<const Constant &>(n).getValue() ? true_id : false_id;
+      break;
+    case Node_Kind::VARIABLE:
+      result = make_variable(static_cast<const Variable &>(n).getLiteral());
+      break;
+    case Node_Kind::AND_GATE:
+    case Node_Kind::OR_GATE: {
+      const bool conjunction = n.getKind() == Node_Kind::AND_GATE;
+      result = conjunction ? true_id : false_id;
+      for (const auto &child : static_cast<const Gate &>(n).getChildren()) {
+        const BddId c = converted.at(child->getId());
+        result = conjunction ? make_and(result, c) : make_or(result, c);
+        if (result == (conjunction ? false_id : true_id))
+          break; // decided
+      }
+      break;
+    }
+    }
+    converted.emplace(n.getId(), result);
+  });
+  return converted.at(f.getId());
+}
+
+bool Bdd_Manager::equivalent(const Formula &f, const Formula &g) {
+  return from_formula(f) == from_formula(g);
+}
+
+std::shared_ptr<Formula> Bdd_Manager::to_formula(BddId root,
+                                                 Logic_Builder &builder) const {
+  // Each inner node becomes OR[AND[x, high], AND[-x, low]]; the builder drops
+  // the constant children. Children are converted before their parents.
+  std::unordered_map<BddId, std::shared_ptr<Formula>> converted;
+  converted.emplace(false_id, builder.make_false());
+  converted.emplace(true_id, builder.make_true());
+  std::vector<BddId> stack{root};
+  while (!stack.empty()) {
+    const BddId f = stack.back();
+    if (converted.count(f)) {
+      stack.pop_back();
+      continue;
+    }
+    const bool low_done = converted.count(lows[f]);
+    const bool high_done = converted.count(highs[f]);
+    if (!low_done)
+      stack.push_back(lows[f]);
+    if (!high_done)
+      stack.push_back(highs[f]);
+    if (!low_done || !high_done)
+      continue;
+    stack.pop_back();
+    const int x = variable(f);
+    converted.emplace(
+        f, builder.make_disjunction(
+               {builder.make_conjunction({builder.make_variable(x), converted.at(highs[f])}),
+                builder.make_conjunction({builder.make_variable(-x), converted.at(lows[f])})}));
+  }
+  return converted.at(root);
+}
+
+uint64_t Bdd_Manager::model_count(BddId root) const {
+  const uint32_t n = variables();
+  assert(n < 64);
+  auto level = [&](BddId f) { return is_terminal(f) ? n : levels[f]; };
+  // models over the variables at and below the level of each node
+  std::unordered_map<BddId, uint64_t> counts{{false_id, 0}, {true_id, 1}};
+  std::vector<BddId> stack{root};
+  while (!stack.empty()) {
+    const BddId f = stack.back();
+    if (counts.count(f)) {
+      stack.pop_back();
+      continue;
+    }
+    auto low = counts.find(lows[f]);
+    auto high = counts.find(highs[f]);
+    if (low == counts.end() || high == counts.end()) {
+      if (low == counts.end())
+        stack.push_back(lows[f]);
+      if (high == counts.end())
+        stack.push_back(highs[f]);
+      continue;
+    }
+    stack.pop_back();
+    // skipped levels between a node and its children are free variables
+    const uint64_t count = (low->second << (level(lows[f]) - level(f) - 1)) +
+                           (high->second << (level(highs[f]) - level(f) - 1));
+    counts.emplace(f, count);
+  }
+  return counts.at(root) << level(root);
+}
+
+void Bdd_Manager::collect_garbage(const std::vector<BddId> &roots) {
+  std::vector<bool> reachable(levels.size(), false);
+  reachable[false_id] = reachable[true_id] = true;
+  std::vector<BddId> stack(roots.begin(), roots.end());
+  while (!stack.empty()) {
+    const BddId f = stack.back();
+    stack.pop_back();
+    if (reachable[f])
+      continue;
+    reachable[f] = true;
+    stack.push_back(lows[f]);
+    stack.push_back(highs[f]);
+  }
+  free_ids.clear();
+  for (BddId id = true_id + 1; id < levels.size(); ++id) {
+    if (!reachable[id])
+      levels[id] = dead_level;
+    if (levels[id] == dead_level)
+      free_ids.push_back(id);
+  }
+  // reuse low ids first
+  std::reverse(free_ids.begin(), free_ids.end());
+  // cached results may refer to freed nodes
+  std::fill(computed.begin(), computed.end(), Cache_Entry{UINT32_MAX, 0, 0, 0});
+  size_t slots = 64;
+  while (slots < 2 * (size() + 1))
+    slots *= 2;
+  rebuild_unique_table(slots);
+}
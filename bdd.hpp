@@ -0,0 +1,114 @@
+#ifndef BDD_HPP
+#define BDD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Logic_Node;
+class Logic_Builder;
+typedef Logic_Node Formula;
+
+typedef uint32_t BddId;
+
+// Heuristics for the variable order, see Bdd_Manager::variable_order
+enum class Bdd_Ordering {
+  NATURAL,          // by increasing variable index
+  FIRST_OCCURRENCE, // in depth-first order of first occurrence
+  FREQUENCY,        // most referenced variables first
+};
+
+// Reduced ordered binary decision diagrams
+//
+// Nodes live in parallel arrays like in Node_Arena and are addressed by
+// BddIds. Ids 0 and 1 are the False and True terminals. A unique table makes
+// every function have exactly one node, so two formulas are equivalent iff
+// their BDDs have the same id. Operations go through if-then-else, whose
+// results are kept in a direct-mapped computed cache.
+//
+// The variable order is fixed once nodes exist: variables not given to
+// set_order are appended below the others when they are first used. There is
+// no dynamic reordering. ITE recurses once per level, so its depth is bounded
+// by the number of variables, not by the size of the formulas.
+//
+// Nodes are not reference counted. collect_garbage frees every node that is
+// not reachable from the roots it is given; the ids of the others are kept.
+class Bdd_Manager {
+public:
+  // `cache_bits` is the log2 of the number of computed cache entries
+  explicit Bdd_Manager(unsigned cache_bits = 16);
+
+  BddId make_false() const { return false_id; }
+  BddId make_true() const { return true_id; }
+  // negative literals give the negation of the variable
+  BddId make_variable(int literal);
+
+  BddId ite(BddId f, BddId g, BddId h);
+  BddId make_not(BddId f) { return ite(f, false_id, true_id); }
+  BddId make_and(BddId f, BddId g) { return ite(f, g, false_id); }
+  BddId make_or(BddId f, BddId g) { return ite(f, true_id, g); }
+
+  // Conversions from and to formulas. Shared subformulas are converted once.
+  BddId from_formula(const Formula &f);
+  std::shared_ptr<Formula> to_formula(BddId f, Logic_Builder &builder) const;
+  // canonical equivalence check
+  bool equivalent(const Formula &f, const Formula &g);
+
+  // Number of models over all variables of the order, which must be fewer
+  // than 64
+  uint64_t model_count(BddId f) const;
+
+  // Must be called before any variable is used. `variables` lists variable
+  // indices (positive literals) from the top of the order to the bottom.
+  void set_order(const std::vector<int> &variables);
+  const std::vector<int> &order() const { return variable_at_level; }
+  size_t variables() const { return variable_at_level.size(); }
+  static std::vector<int>
+  variable_order(const std::vector<std::shared_ptr<Formula>> &formulas,
+                 Bdd_Ordering ordering);
+
+  // variable and children of an inner node
+  int variable(BddId f) const { return variable_at_level[levels[f]]; }
+  BddId low(BddId f) const { return lows[f]; }
+  BddId high(BddId f) const { return highs[f]; }
+  bool is_terminal(BddId f) const { return f <= true_id; }
+
+  // live nodes, terminals included
+  size_t size() const { return levels.size() - free_ids.size(); }
+  void collect_garbage(const std::vector<BddId> &roots);
+
+private:
+  static constexpr BddId false_id = 0;
+  static constexpr BddId true_id = 1;
+  // level of the terminals, below every variable
+  static constexpr uint32_t terminal_level = UINT32_MAX;
+  // level of freed nodes
+  static constexpr uint32_t dead_level = UINT32_MAX - 1;
+
+  std::vector<uint32_t> levels;
+  std::vector<BddId> lows;
+  std::vector<BddId> highs;
+  std::vector<BddId> free_ids;
+
+  // open addressing, stores id + 1 and 0 for empty slots
+  std::vector<uint32_t> unique_table;
+  size_t unique_entries = 0;
+
+  struct Cache_Entry {
+    BddId f, g, h, result;
+  };
+  std::vector<Cache_Entry> computed;
+
+  std::vector<uint32_t> level_of_variable; // indexed by variable - 1
+  std::vector<int> variable_at_level;
+
+  uint32_t level_of(int variable);
+  BddId make_node(uint32_t level, BddId low, BddId high);
+  void insert_unique(BddId id);
+  void rebuild_unique_table(size_t slots);
+  size_t node_hash(uint32_t level, BddId low, BddId high) const;
+  BddId cofactor(BddId f, uint32_t level, bool value) const;
+};
+
+#endif // BDD_HPP
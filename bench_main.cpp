@@ -0,0 +1,379 @@
+#include "logic_builder.hpp"
+#include "logic_node.hpp"
+#include "logic_program.hpp"
+#include "random.hpp"
+#include "simplifier_cache.hpp"
+#include "traversal.hpp"
+#include "wide_evaluation.hpp"
+#include "workload_generator.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/resource.h>
+
+// Microbenchmarks of the builder, simplify, normalize, hashing, equality and
+// evaluation
+//
+//   bench_main [--filter TEXT] [--min-time SECONDS] [--json FILE]
+//              [--baseline FILE] [--threshold RATIO]
+//
+// Every benchmark repeats one operation until it has run for the minimum
+// time, then reports the time and the heap allocations per operation. The
+// peak resident set size is that of the process after the benchmark. With
+// --json the results are saved, and with --baseline they are compared with
+// saved ones: the exit status is 1 if a benchmark got slower than the
+// threshold ratio (1.15 by default).
+//
+// Build it with `make bench`, which compiles without sanitizers.
+
+// Allocation counting: every operator new of the process goes through here
+static std::atomic<uint64_t> allocations{0};
+
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+// over-aligned types, such as the shards of the simplifier cache
+void *operator new(size_t size, std::align_val_t alignment) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  const size_t align = static_cast<size_t>(alignment);
+  // aligned_alloc wants a nonzero multiple of the alignment
+  const size_t rounded = size ? (size + align - 1) / align * align : align;
+  if (void *p = std::aligned_alloc(align, rounded))
+    return p;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size, std::align_val_t alignment) {
+  return operator new(size, alignment);
+}
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace {
+
+struct Result {
+  std::string name;
+  uint64_t iterations;
+  double ns_per_op;
+  double allocations_per_op;
+  long peak_rss_kb;
+};
+
+long peak_rss_kb() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+// keeps a result alive so that the operation is not optimized away
+template <typename T> void keep(const T &value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct Options {
+  std::string filter;
+  double min_time = 0.2;
+  std::string json;
+  std::string baseline;
+  double threshold = 1.15;
+};
+
+class Runner {
+public:
+  explicit Runner(const Options &options) : options(options) {}
+
+  bool selected(const std::string &name) const {
+    return name.find(options.filter) != std::string::npos;
+  }
+
+  // Runs `operation` in batches of doubling size until the minimum time is
+  // reached. With a `setup`, it runs before every operation, outside of the
+  // measurement, which then times each operation on its own.
+  void run(const std::string &name, const std::function<void()> &operation,
+           const std::function<void()> &setup = {}) {
+    if (!selected(name))
+      return;
+    using clock = std::chrono::steady_clock;
+    uint64_t iterations = 0, batch = 1, allocated = 0;
+    double elapsed = 0;
+    while (elapsed < options.min_time) {
+      for (uint64_t i = 0; i < (setup ? batch : 1); ++i) {
+        if (setup)
+          setup();
+        const uint64_t allocated_before = allocations.load(std::memory_order_relaxed);
+        const auto start = clock::now();
+        for (uint64_t k = 0; k < (setup ? 1 : batch); ++k)
+          operation();
+        elapsed += std::chrono::duration<double>(clock::now() - start).count();
+        allocated += allocations.load(std::memory_order_relaxed) - allocated_before;
+      }
+      iterations += batch;
+      batch *= 2;
+    }
+    record({name, iterations, elapsed * 1e9 / iterations, double(allocated) / iterations,
+            peak_rss_kb()});
+  }
+
+  void skip(const std::string &name, const std::string &reason) {
+    if (selected(name))
+      std::printf("%-48s skipped, %s\n", name.c_str(), reason.c_str());
+  }
+
+  const std::vector<Result> &get_results() const { return results; }
+
+private:
+  const Options &options;
+  std::vector<Result> results;
+
+  void record(const Result &result) {
+    std::printf("%-48s %12.1f ns/op %10.2f allocs/op %8ld KB peak\n", result.name.c_str(),
+                result.ns_per_op, result.allocations_per_op, result.peak_rss_kb);
+    std::fflush(stdout);
+    results.push_back(result);
+  }
+};
+
+// Number of nodes of `f` counted once per path, as walked by the tree
+// algorithms: deep equality, plain, batch and wide evaluation, and normalize
+double tree_size(const Formula &f) {
+  std::unordered_map<const Logic_Node *, double> size;
+  for_each_node(f, Visit_Order::POST_ORDER, [&size](const Logic_Node &n) {
+    double total = 1;
+    if (const Gate *gate = as_gate(n))
+      for (const auto &child : gate->getChildren())
+        total += size[child.get()];
+    size[&n] = total;
+  });
+  return size[&f];
+}
+
+struct Shape {
+  size_t gates;
+  size_t depth;
+  double sharing;
+
+  std::shared_ptr<Formula> generate(Logic_Builder &builder, uint64_t seed) const {
+    return generate_workload(builder, {.gates = gates, .depth = depth, .sharing = sharing,
+                                       .seed = seed});
+  }
+
+  std::string label() const {
+    std::ostringstream out;
+    out << "/g" << gates << "/d" << depth << "/s" << sharing;
+    return out.str();
+  }
+};
+
+void bench_builder(Runner &runner) {
+  for (bool consing : {false, true}) {
+    const std::string mode = consing ? "/consing" : "/plain";
+    Logic_Builder builder(consing);
+    std::vector<std::shared_ptr<Formula>> variables;
+    for (int v = 1; v <= 64; ++v)
+      variables.push_back(builder.make_variable(v));
+    Random random(1);
+    std::vector<std::shared_ptr<Formula>> children(4);
+    auto pick = [&]() {
+      for (auto &child : children)
+        child = variables[random.pick_int(0, 63)];
+    };
+    runner.run("make_conjunction/4" + mode, [&]() {
+      pick();
+      keep(builder.make_conjunction(children));
+    });
+    runner.run("make_disjunction/4" + mode, [&]() {
+      pick();
+      keep(builder.make_disjunction(children));
+    });
+  }
+
+  // a formula of a log line, through operator<<
+  Logic_Builder builder;
+  const auto small = builder.make_conjunction({builder.make_variable(1), builder.make_variable(-2)});
+  std::ostringstream out;
+  runner.run("print/stream_small", [&]() {
+    out.seekp(0);
+    out << *small;
+  });
+}
+
+void bench_shape(Runner &runner, const Shape &shape) {
+  const std::string label = shape.label();
+  Logic_Builder builder;
+  builder.set_cache_scope(Cache_Scope::BUILDER);
+  auto f = shape.generate(builder, 42);
+  auto copy = shape.generate(builder, 42);
+  const double dag = builder.dag_size(*f), tree = tree_size(*f);
+  std::printf("%s: %.0f nodes, %.3g as a tree\n", label.c_str() + 1, dag, tree);
+  // walks of every path are only timed while they stay close to the DAG
+  const bool walk_tree = tree <= 50 * dag;
+
+  // the cache is cleared before every run, outside of the measurement
+  runner.run("simplify/cold" + label, [&]() { keep(builder.simplify(f)); },
+             [&]() { builder.clear_cache(); });
+  builder.simplify(f);
+  runner.run("simplify/warm" + label, [&]() { keep(builder.simplify(f)); });
+
+  Logic_Builder consing(true);
+  consing.set_cache_scope(Cache_Scope::BUILDER);
+  runner.run("simplify/consing_cold" + label, [&]() { keep(consing.simplify(f)); },
+             [&]() { consing.clear_cache(); });
+
+  // normalize works in place, so every run starts from a fresh copy that
+  // still has its duplicates
+  std::shared_ptr<Formula> target;
+  if (walk_tree)
+    runner.run("normalize" + label, [&]() { builder.normalize(target); },
+               [&]() { target = shape.generate(builder, 7); });
+  else
+    runner.skip("normalize" + label, "exponential tree");
+
+  runner.run("hash/stored" + label, [&]() { keep(Logic_Node_Hash()(f)); });
+  const Gate &root = static_cast<const Gate &>(*f);
+  runner.run("hash/recompute_root" + label,
+             [&]() { keep(Gate::hash_of(root.getType(), root.getChildren())); });
+  if (walk_tree)
+    runner.run("equality/deep" + label, [&]() { keep(*f == *copy); });
+  else
+    runner.skip("equality/deep" + label, "exponential tree");
+
+  std::vector<bool> model(64);
+  Random random(3);
+  for (size_t i = 0; i < model.size(); ++i)
+    model[i] = random.generate_bool();
+  if (walk_tree)
+    runner.run("evaluate/tree" + label, [&]() { keep(builder.evaluate(f, model)); });
+  else
+    runner.skip("evaluate/tree" + label, "exponential tree");
+  runner.run("evaluate/memoized" + label, [&]() { keep(builder.evaluate_memoized(*f, model)); });
+  const Logic_Program program = builder.compile(f);
+  runner.run("evaluate/program" + label, [&]() { keep(program.evaluate(model)); });
+  std::vector<uint64_t> models(64);
+  for (auto &word : models)
+    word = uint64_t(random.generate()) << 32 | random.generate();
+  if (walk_tree)
+    runner.run("evaluate/batch64" + label, [&]() { keep(builder.evaluate_batch(f, models)); });
+  else
+    runner.skip("evaluate/batch64" + label, "exponential tree");
+  runner.run("evaluate/program_batch64" + label, [&]() { keep(program.evaluate_batch(models)); });
+
+  // 1024 models per call with each kernel the CPU supports
+  constexpr size_t wide_words = 16;
+  std::vector<uint64_t> wide_models(64 * wide_words);
+  for (auto &word : wide_models)
+    word = uint64_t(random.generate()) << 32 | random.generate();
+  const Wide_Kernel detected = wide_kernel();
+  for (Wide_Kernel kernel : {Wide_Kernel::SCALAR, Wide_Kernel::AVX2, Wide_Kernel::AVX512}) {
+    const std::string name = std::string("evaluate/wide1024_") + wide_kernel_name(kernel) + label;
+    if (!wide_kernel_supported(kernel)) {
+      runner.skip(name, "not supported by this CPU");
+    } else if (!walk_tree) {
+      runner.skip(name, "exponential tree");
+    } else {
+      set_wide_kernel(kernel);
+      runner.run(name, [&]() { keep(evaluate_wide(*f, wide_models, wide_words)); });
+    }
+  }
+  set_wide_kernel(detected);
+}
+
+void write_json(const std::string &path, const std::vector<Result> &results) {
+  std::ofstream out(path);
+  out << "[\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result &r = results[i];
+    out << "  {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+        << ", \"ns_per_op\": " << r.ns_per_op
+        << ", \"allocations_per_op\": " << r.allocations_per_op
+        << ", \"peak_rss_kb\": " << r.peak_rss_kb << "}" << (i + 1 < results.size() ? "," : "")
+        << "\n";
+  }
+  out << "]\n";
+}
+
+// Reads the name and ns_per_op of each entry of a file written by write_json
+std::map<std::string, double> read_baseline(const std::string &path) {
+  std::map<std::string, double> times;
+  std::ifstream in(path);
+  const std::string name_key = "\"name\": \"", time_key = "\"ns_per_op\": ";
+  for (std::string line; std::getline(in, line);) {
+    const size_t name = line.find(name_key), time = line.find(time_key);
+    if (name == std::string::npos || time == std::string::npos)
+      continue;
+    const size_t start = name + name_key.size();
+    times[line.substr(start, line.find('"', start) - start)] =
+        std::strtod(line.c_str() + time + time_key.size(), nullptr);
+  }
+  return times;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const std::string option = argv[i], value = argv[i + 1];
+    if (option == "--filter")
+      options.filter = value;
+    else if (option == "--min-time")
+      options.min_time = std::stod(value);
+    else if (option == "--json")
+      options.json = value;
+    else if (option == "--baseline")
+      options.baseline = value;
+    else if (option == "--threshold")
+      options.threshold = std::stod(value);
+    else {
+      std::cerr << "unknown option " << option << "\n";
+      return 2;
+    }
+  }
+
+  Runner runner(options);
+  bench_builder(runner);
+  for (const Shape &shape : {Shape{1 << 10, 8, 0.0}, Shape{1 << 10, 8, 0.5},
+                             Shape{1 << 16, 16, 0.3}, Shape{1 << 14, 2048, 0.2}})
+    bench_shape(runner, shape);
+
+  if (!options.json.empty())
+    write_json(options.json, runner.get_results());
+  if (options.baseline.empty())
+    return 0;
+
+  const auto baseline = read_baseline(options.baseline);
+  int regressions = 0;
+  std::printf("\ncompared with %s\n", options.baseline.c_str());
+  for (const Result &r : runner.get_results()) {
+    const auto old = baseline.find(r.name);
+    if (old == baseline.end() || old->second <= 0)
+      continue;
+    const double ratio = r.ns_per_op / old->second;
+    const bool regressed = ratio > options.threshold;
+    regressions += regressed;
+    std::printf("%-48s %7.3fx%s\n", r.name.c_str(), ratio, regressed ? "  REGRESSION" : "");
+  }
+  std::printf("%d regressions over %.2fx\n", regressions, options.threshold);
+  return regressions ? 1 : 0;
+}
@@ -0,0 +1,40 @@
+#include "buffered_writer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <cstring>
+
+Buffered_Writer::Buffered_Writer(std::ostream &out, size_t capacity)
+    : out(out), capacity(std::max<size_t>(capacity, 32)),
+      owned(std::make_unique_for_overwrite<char[]>(this->capacity)), buffer(owned.get()) {}
+
+Buffered_Writer::Buffered_Writer(std::ostream &out, char *storage, size_t capacity)
+    : out(out), capacity(capacity), buffer(storage) {
+  assert(capacity >= 32);
+}
+
+void Buffered_Writer::write(std::string_view text) {
+  while (!text.empty()) {
+    if (used == capacity)
+      flush();
+    const size_t n = std::min(text.size(), capacity - used);
+    std::memcpy(buffer + used, text.data(), n);
+    used += n;
+    text.remove_prefix(n);
+  }
+}
+
+void Buffered_Writer::write_int(int64_t value) {
+  // 20 characters hold every int64_t
+  if (capacity - used < 20)
+    flush();
+  char *end = std::to_chars(buffer + used, buffer + capacity, value).ptr;
+  used = end - buffer;
+}
+
+void Buffered_Writer::flush() {
+  out.write(buffer, used);
+  flushed += used;
+  used = 0;
+}
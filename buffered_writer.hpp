@@ -0,0 +1,46 @@
+#ifndef BUFFERED_WRITER_HPP
+#define BUFFERED_WRITER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+// Output buffer for writers of large files
+//
+// Formatting numbers into a private buffer and handing it to the stream in
+// large blocks avoids the per-call overhead of operator<<, which dominates
+// when writing millions of small tokens. The buffer is flushed when it is full
+// and on destruction. It is not zero-filled, so a writer is cheap to create
+// even for a short output.
+class Buffered_Writer {
+public:
+  explicit Buffered_Writer(std::ostream &out, size_t capacity = 1 << 16);
+  // writes through `storage`, owned by the caller, for writers created often
+  Buffered_Writer(std::ostream &out, char *storage, size_t capacity);
+  ~Buffered_Writer() { flush(); }
+  Buffered_Writer(const Buffered_Writer &) = delete;
+  Buffered_Writer &operator=(const Buffered_Writer &) = delete;
+
+  void put(char c) {
+    if (used == capacity)
+      flush();
+    buffer[used++] = c;
+  }
+  void write(std::string_view text);
+  void write_int(int64_t value);
+  void flush();
+  // characters written so far, flushed or not
+  uint64_t written() const { return flushed + used; }
+
+private:
+  std::ostream &out;
+  const size_t capacity;
+  std::unique_ptr<char[]> owned;
+  char *const buffer;
+  size_t used = 0;
+  uint64_t flushed = 0;
+};
+
+#endif // BUFFERED_WRITER_HPP
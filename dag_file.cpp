@@ -0,0 +1,362 @@
+#include "dag_file.hpp"
+#include "buffered_writer.hpp"
+#include "logic_builder.hpp"
+#include "logic_node.hpp"
+#include "mapped_file.hpp"
+#include "traversal.hpp"
+
+#include <cassert>
+#include <climits>
+#include <cstdlib>
+#include <utility>
+
+namespace {
+
+constexpr char magic[4] = {'L', 'D', 'A', 'G'};
+constexpr uint32_t version = 1;
+constexpr size_t header_size = 32;
+
+enum Dag_Kind : uint64_t { CONSTANT = 0, VARIABLE = 1, AND_GATE = 2, OR_GATE = 3 };
+
+uint64_t zigzag(int literal) {
+  const int64_t value = literal;
+  return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+  return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+size_t varint_size(uint64_t value) {
+  size_t size = 1;
+  for (; value >= 0x80; value >>= 7)
+    ++size;
+  return size;
+}
+
+void write_varint(Buffered_Writer &writer, uint64_t value) {
+  for (; value >= 0x80; value >>= 7)
+    writer.put(char(value | 0x80));
+  writer.put(char(value));
+}
+
+void write_le(Buffered_Writer &writer, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i, value >>= 8)
+    writer.put(char(value & 0xff));
+}
+
+uint64_t read_le(const unsigned char *p, int bytes) {
+  uint64_t value = 0;
+  for (int i = bytes - 1; i >= 0; --i)
+    value = value << 8 | p[i];
+  return value;
+}
+
+// for validated input
+uint64_t read_varint(const unsigned char *&p) {
+  uint64_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    const unsigned char byte = *p++;
+    value |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return value;
+  }
+}
+
+// Returns false if the varint is truncated or does not fit in 64 bits
+bool read_varint_checked(std::string_view bytes, size_t &position, uint64_t &value) {
+  value = 0;
+  for (int shift = 0; position < bytes.size(); shift += 7) {
+    const unsigned char byte = bytes[position++];
+    if (shift == 63 && byte > 1)
+      return false;
+    value |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+    if (shift == 63)
+      return false;
+  }
+  return false;
+}
+
+// Assigns every distinct node its index in post-order, across all the roots
+struct Numbering_Visitor {
+  Node_Table<uint64_t> &index;
+  std::vector<const Logic_Node *> &order;
+  uint64_t edges = 0;
+
+  bool enter(const Logic_Node &n) {
+    if (index.find(n))
+      return false;
+    if (!n.isGate()) {
+      leave(n);
+      return false;
+    }
+    return true;
+  }
+  bool child_done(const Logic_Node &, size_t) { return true; }
+  void leave(const Logic_Node &n) {
+    index.insert(n, order.size());
+    order.push_back(&n);
+    if (n.isGate())
+      edges += n.arity(); // variables have arity 1
+  }
+};
+
+uint64_t head_of(const Logic_Node &n) {
+  switch (n.getKind()) {
+  case Node_Kind::CONSTANT:
+    return uint64_t(static_cast<const Constant &>(n).getValue()) << 2 | CONSTANT;
+  case Node_Kind::VARIABLE:
+    return zigzag(static_cast<const Variable &>(n).getLiteral()) << 2 | VARIABLE;
+  case Node_Kind::AND_GATE:
+    return uint64_t(n.arity()) << 2 | AND_GATE;
+  case Node_Kind::OR_GATE:
+    break;
+  }
+  return uint64_t(n.arity()) << 2 | OR_GATE;
+}
+
+} // namespace
+
+Dag_Statistics write_dag(std::ostream &out,
+                         const std::vector<std::shared_ptr<Formula>> &roots) {
+  Node_Table<uint64_t> index;
+  std::vector<const Logic_Node *> order;
+  Numbering_Visitor numbering{index, order};
+  for (const auto &root : roots)
+    walk_formula(*root, numbering);
+
+  Buffered_Writer writer(out);
+  writer.write(std::string_view(magic, sizeof magic));
+  write_le(writer, version, 4);
+  write_le(writer, order.size(), 8);
+  write_le(writer, roots.size(), 8);
+  write_le(writer, numbering.edges, 8);
+  uint64_t bytes = header_size;
+  for (const auto &root : roots) {
+    const uint64_t root_index = *index.find(*root);
+    write_varint(writer, root_index);
+    bytes += varint_size(root_index);
+  }
+  for (uint64_t i = 0; i < order.size(); ++i) {
+    const uint64_t head = head_of(*order[i]);
+    write_varint(writer, head);
+    bytes += varint_size(head);
+    if (const Gate *gate = as_gate(*order[i])) {
+      for (const auto &child : gate->getChildren()) {
+        const uint64_t delta = i - *index.find(*child);
+        write_varint(writer, delta);
+        bytes += varint_size(delta);
+      }
+    }
+  }
+  writer.flush();
+  return {order.size(), numbering.edges, bytes};
+}
+
+Dag_Reader::Dag_Reader(std::string_view bytes) : bytes(bytes) { validate(); }
+
+Dag_Reader::Dag_Reader(Dag_Reader &&) noexcept = default;
+
+Dag_Reader::~Dag_Reader() = default;
+
+Dag_Reader Dag_Reader::map_file(const std::string &path) {
+  auto file = std::make_unique<Mapped_File>(path);
+  if (!file->is_open()) {
+    Dag_Reader reader{std::string_view()};
+    reader.failure = file->error();
+    return reader;
+  }
+  Dag_Reader reader(file->contents());
+  reader.file = std::move(file);
+  return reader;
+}
+
+void Dag_Reader::validate() {
+  auto fail = [this](size_t offset, const std::string &message) {
+    failure = "byte " + std::to_string(offset) + ": " + message;
+  };
+  const auto *data = reinterpret_cast<const unsigned char *>(bytes.data());
+  if (bytes.size() < header_size) {
+    fail(bytes.size(), "truncated header");
+    return;
+  }
+  if (bytes.substr(0, sizeof magic) != std::string_view(magic, sizeof magic)) {
+    fail(0, "not a formula DAG file");
+    return;
+  }
+  if (read_le(data + 4, 4) != version) {
+    fail(4, "unsupported version " + std::to_string(read_le(data + 4, 4)));
+    return;
+  }
+  nodes = read_le(data + 8, 8);
+  const uint64_t root_total = read_le(data + 16, 8);
+  edges = read_le(data + 24, 8);
+  // every node and root takes at least one byte, which also bounds the
+  // allocations below
+  if (nodes > bytes.size() || root_total > bytes.size() - nodes) {
+    fail(8, "counts larger than the file");
+    return;
+  }
+
+  size_t position = header_size;
+  uint64_t value = 0;
+  roots.reserve(root_total);
+  for (uint64_t i = 0; i < root_total; ++i) {
+    const size_t start = position;
+    if (!read_varint_checked(bytes, position, value)) {
+      fail(start, "invalid varint");
+      return;
+    }
+    if (value >= nodes) {
+      fail(start, "root " + std::to_string(value) + " out of range");
+      return;
+    }
+    roots.push_back(value);
+  }
+
+  body = position;
+  uint64_t edges_seen = 0;
+  for (uint64_t i = 0; i < nodes; ++i) {
+    const size_t start = position;
+    if (!read_varint_checked(bytes, position, value)) {
+      fail(start, "invalid varint");
+      return;
+    }
+    const uint64_t payload = value >> 2;
+    switch (value & 3) {
+    case CONSTANT:
+      if (payload > 1) {
+        fail(start, "invalid constant");
+        return;
+      }
+      break;
+    case VARIABLE: {
+      const int64_t literal = unzigzag(payload);
+      if (literal == 0 || literal < INT_MIN || literal > INT_MAX) {
+        fail(start, "invalid literal");
+        return;
+      }
+      break;
+    }
+    default:
+      if (payload > bytes.size() - position) {
+        fail(start, "arity larger than the file");
+        return;
+      }
+      for (uint64_t k = 0; k < payload; ++k) {
+        const size_t child = position;
+        if (!read_varint_checked(bytes, position, value)) {
+          fail(child, "invalid varint");
+          return;
+        }
+        if (value == 0 || value > i) {
+          fail(child, "child does not precede its parent");
+          return;
+        }
+      }
+      edges_seen += payload;
+    }
+  }
+  if (position != bytes.size()) {
+    fail(position, "trailing bytes after the last node");
+    return;
+  }
+  if (edges_seen != edges) {
+    fail(24, "edge count does not match the nodes");
+    return;
+  }
+}
+
+// One linear pass over the nodes. Every child has to be decoded anyway to
+// find the next node, so gates do not stop at a controlling value.
+template <typename Value, typename Leaf>
+void Dag_Reader::evaluate_nodes(std::vector<Value> &values, Leaf leaf) const {
+  assert(valid());
+  const Value all = ~Value(0);
+  values.resize(nodes);
+  const auto *p = reinterpret_cast<const unsigned char *>(bytes.data()) + body;
+  for (uint64_t i = 0; i < nodes; ++i) {
+    const uint64_t head = read_varint(p);
+    const uint64_t payload = head >> 2;
+    Value value;
+    switch (head & 3) {
+    case CONSTANT:
+      value = payload ? all : 0;
+      break;
+    case VARIABLE:
+      value = leaf(int(unzigzag(payload)));
+      break;
+    case AND_GATE:
+      value = all;
+      for (uint64_t k = 0; k < payload; ++k)
+        value &= values[i - read_varint(p)];
+      break;
+    default:
+      value = 0;
+      for (uint64_t k = 0; k < payload; ++k)
+        value |= values[i - read_varint(p)];
+    }
+    values[i] = value;
+  }
+}
+
+std::vector<bool> Dag_Reader::evaluate(const std::vector<bool> &model) const {
+  evaluate_nodes(values, [&model](int literal) -> uint8_t {
+    const int index = std::abs(literal) - 1;
+    if (index >= static_cast<int>(model.size()))
+      return 0;
+    return model[index] == (literal > 0) ? 0xff : 0;
+  });
+  std::vector<bool> result;
+  result.reserve(roots.size());
+  for (uint64_t root : roots)
+    result.push_back(values[root]);
+  return result;
+}
+
+std::vector<uint64_t>
+Dag_Reader::evaluate_batch(const std::vector<uint64_t> &models) const {
+  evaluate_nodes(batch_values, [&models](int literal) -> uint64_t {
+    const int index = std::abs(literal) - 1;
+    if (index >= static_cast<int>(models.size()))
+      return 0;
+    return literal > 0 ? models[index] : ~models[index];
+  });
+  std::vector<uint64_t> result;
+  result.reserve(roots.size());
+  for (uint64_t root : roots)
+    result.push_back(batch_values[root]);
+  return result;
+}
+
+std::vector<std::shared_ptr<Formula>> Dag_Reader::load(Logic_Builder &builder) const {
+  assert(valid());
+  std::vector<std::shared_ptr<Formula>> built(nodes);
+  std::vector<std::shared_ptr<Formula>> children;
+  const auto *p = reinterpret_cast<const unsigned char *>(bytes.data()) + body;
+  for (uint64_t i = 0; i < nodes; ++i) {
+    const uint64_t head = read_varint(p);
+    const uint64_t payload = head >> 2;
+    switch (head & 3) {
+    case CONSTANT:
+      built[i] = payload ? builder.make_true() : builder.make_false();
+      break;
+    case VARIABLE:
+      built[i] = builder.make_variable(int(unzigzag(payload)));
+      break;
+    default:
+      children.clear();
+      for (uint64_t k = 0; k < payload; ++k)
+        children.push_back(built[i - read_varint(p)]);
+      built[i] = (head & 3) == AND_GATE ? builder.make_conjunction(children)
+                                        : builder.make_disjunction(children);
+    }
+  }
+  std::vector<std::shared_ptr<Formula>> result;
+  result.reserve(roots.size());
+  for (uint64_t root : roots)
+    result.push_back(built[root]);
+  return result;
+}
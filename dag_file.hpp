@@ -0,0 +1,96 @@
+#ifndef DAG_FILE_HPP
+#define DAG_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Logic_Node;
+class Logic_Builder;
+class Mapped_File;
+typedef Logic_Node Formula;
+
+// Binary format for sets of formulas, with sharing preserved
+//
+// Every distinct node of the set is written once, in post-order, so the
+// children of a node come before it and a reader needs a single linear pass.
+// Nodes are referred to by their index in that order. All integers after the
+// header are LEB128 varints.
+//
+//   header   "LDAG", version (u32), nodes, roots, edges (u64), little-endian
+//   roots    index of each formula of the set
+//   nodes    head = payload << 2 | kind, then for a gate one varint
+//            index - child_index per child
+//
+// The kind is 0 for constants, 1 for variables, 2 for AND and 3 for OR. The
+// payload is the value of a constant, the zigzag-encoded literal of a
+// variable, the arity of a gate. Child deltas are small for the local edges
+// that dominate, which keeps most references on one byte.
+
+struct Dag_Statistics {
+  uint64_t nodes;
+  uint64_t edges;
+  uint64_t bytes;
+};
+
+// Writes `roots`, which may share subformulas, in the format above
+Dag_Statistics write_dag(std::ostream &out,
+                         const std::vector<std::shared_ptr<Formula>> &roots);
+
+// Reader over a buffer in the format above, typically a mapped file
+//
+// The whole buffer is validated once at construction, hence evaluate and
+// load decode it afterwards without checks. evaluate works directly on the
+// bytes with one value per node and builds no Formula. The scratch values are
+// kept between calls, hence one reader must not evaluate from several
+// threads at once.
+class Dag_Reader {
+public:
+  // `bytes` must outlive the reader
+  explicit Dag_Reader(std::string_view bytes);
+  // maps the file, which is then owned by the reader
+  static Dag_Reader map_file(const std::string &path);
+  Dag_Reader(Dag_Reader &&) noexcept;
+  ~Dag_Reader();
+
+  bool valid() const { return failure.empty(); }
+  // reason and byte offset of the first problem found, empty if valid
+  const std::string &error() const { return failure; }
+
+  uint64_t node_count() const { return nodes; }
+  uint64_t root_count() const { return roots.size(); }
+  uint64_t edge_count() const { return edges; }
+
+  // value of each root, same semantics as Logic_Node::evaluation
+  std::vector<bool> evaluate(const std::vector<bool> &model) const;
+  // value of each root for 64 models, same semantics as
+  // Logic_Node::evaluation_batch
+  std::vector<uint64_t> evaluate_batch(const std::vector<uint64_t> &models) const;
+  // Rebuilds the roots through `builder`, every node once. The builder drops
+  // constant children as usual, so with hash-consing the result is equivalent
+  // to what was written, not always identical.
+  std::vector<std::shared_ptr<Formula>> load(Logic_Builder &builder) const;
+
+private:
+  std::unique_ptr<Mapped_File> file;
+  std::string_view bytes;
+  std::string failure;
+  uint64_t nodes = 0;
+  uint64_t edges = 0;
+  std::vector<uint64_t> roots;
+  // offset of the first node
+  size_t body = 0;
+
+  mutable std::vector<uint8_t> values;
+  mutable std::vector<uint64_t> batch_values;
+
+  void validate();
+  template <typename Value, typename Leaf>
+  void evaluate_nodes(std::vector<Value> &values, Leaf leaf) const;
+};
+
+#endif // DAG_FILE_HPP
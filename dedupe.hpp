@@ -0,0 +1,72 @@
+#ifndef DEDUPE_HPP
+#define DEDUPE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Removes the repeated elements of `items` in place, keeping the first
+// occurrence of each so that the order is preserved. Elements are compared
+// through `key`, which maps them to a totally ordered value such as a
+// pointer or an id.
+//
+// Narrow vectors are scanned against the elements kept so far. Wider ones
+// sort a copy of the keys, which costs O(k log k) and one allocation, and
+// return at once when nothing is repeated, the common case.
+template <typename T, typename Key>
+void keep_first_occurrences(std::vector<T> &items, Key key) {
+  constexpr size_t linear_limit = 16;
+  if (items.size() <= linear_limit) {
+    size_t kept = 0;
+    for (size_t i = 0; i < items.size(); ++i) {
+      bool seen = false;
+      for (size_t j = 0; j < kept && !seen; ++j)
+        seen = key(items[j]) == key(items[i]);
+      if (!seen) {
+        if (kept != i)
+          items[kept] = std::move(items[i]);
+        ++kept;
+      }
+    }
+    items.resize(kept);
+    return;
+  }
+
+  using Value = decltype(key(items[0]));
+  std::vector<Value> sorted;
+  sorted.reserve(items.size());
+  for (const T &item : items)
+    sorted.push_back(key(item));
+  std::sort(sorted.begin(), sorted.end());
+  if (std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end())
+    return;
+
+  // keep the repeated keys only, each once, with a flag set at first sight
+  size_t repeated = 0;
+  for (size_t i = 0; i + 1 < sorted.size();) {
+    size_t end = i + 1;
+    while (end < sorted.size() && sorted[end] == sorted[i])
+      ++end;
+    if (end - i > 1)
+      sorted[repeated++] = sorted[i];
+    i = end;
+  }
+  sorted.resize(repeated);
+  std::vector<bool> seen(repeated, false);
+  size_t kept = 0;
+  for (size_t i = 0; i < items.size(); ++i) {
+    const auto found = std::lower_bound(sorted.begin(), sorted.end(), key(items[i]));
+    if (found != sorted.end() && *found == key(items[i])) {
+      const size_t index = found - sorted.begin();
+      if (seen[index])
+        continue;
+      seen[index] = true;
+    }
+    if (kept != i)
+      items[kept] = std::move(items[i]);
+    ++kept;
+  }
+  items.resize(kept);
+}
+
+#endif // DEDUPE_HPP
@@ -0,0 +1,37 @@
+#include "dimacs.hpp"
+#include "buffered_writer.hpp"
+#include "logic_node.hpp"
+#include "tseitin.hpp"
+
+#include <vector>
+
+Cnf_Statistics write_dimacs(std::ostream &out, const Formula &f,
+                            bool plaisted_greenbaum) {
+  const int inputs = max_variable(f);
+  const Polarity polarity = plaisted_greenbaum ? Polarity::POSITIVE : Polarity::BOTH;
+
+  Tseitin_Encoder counter(inputs, [](const std::vector<int> &) {}, plaisted_greenbaum);
+  counter.encode(f, polarity);
+  // the unit clause of the root
+  const Cnf_Statistics statistics{counter.variables(), counter.clauses() + 1};
+
+  Buffered_Writer writer(out);
+  writer.write("c variables 1 to ");
+  writer.write_int(inputs);
+  writer.write(" are the variables of the formula\np cnf ");
+  writer.write_int(statistics.variables);
+  writer.put(' ');
+  writer.write_int(statistics.clauses);
+  writer.put('\n');
+  auto write_clause = [&writer](const std::vector<int> &clause) {
+    for (int literal : clause) {
+      writer.write_int(literal);
+      writer.put(' ');
+    }
+    writer.write("0\n");
+  };
+  Tseitin_Encoder encoder(inputs, write_clause, plaisted_greenbaum);
+  write_clause({encoder.encode(f, polarity)});
+  writer.flush();
+  return statistics;
+}
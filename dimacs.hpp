@@ -0,0 +1,27 @@
+#ifndef DIMACS_HPP
+#define DIMACS_HPP
+
+#include <cstdint>
+#include <ostream>
+
+class Logic_Node;
+typedef Logic_Node Formula;
+
+struct Cnf_Statistics {
+  int variables;
+  uint64_t clauses;
+};
+
+// Writes the Tseitin encoding of `f` in DIMACS format, with the literal of
+// `f` asserted: the CNF is satisfiable iff `f` is. Variables 1 to
+// max_variable(f) are those of `f`, so a model of the CNF restricted to them
+// is a model of `f`. The other variables stand for the distinct gates.
+//
+// Clauses are written as they are produced and never kept. The header needs
+// the counts first, so the encoding is run twice, the first time only to
+// count. Plaisted-Greenbaum encoding emits only the positive implications of
+// the gates, about half the clauses.
+Cnf_Statistics write_dimacs(std::ostream &out, const Formula &f,
+                            bool plaisted_greenbaum = false);
+
+#endif // DIMACS_HPP
@@ -0,0 +1,234 @@
+#include "formula_parser.hpp"
+#include "logic_builder.hpp"
+#include "logic_node.hpp"
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <iterator>
+#include <ostream>
+
+std::ostream &operator<<(std::ostream &stream, const Parse_Error &error) {
+  return stream << error.line << ":" << error.column << ": " << error.message;
+}
+
+static bool is_space(char c) {
+  return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+static void skip_space(std::string_view text, size_t &position) {
+  while (position < text.size() && is_space(text[position]))
+    ++position;
+}
+
+static bool skip_keyword(std::string_view text, size_t &position, std::string_view keyword) {
+  if (text.compare(position, keyword.size(), keyword) != 0)
+    return false;
+  position += keyword.size();
+  return true;
+}
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// `keyword` as a whole word, not the prefix of a longer one
+static bool skip_word(std::string_view text, size_t &position, std::string_view keyword) {
+  const size_t end = position + keyword.size();
+  if (text.compare(position, keyword.size(), keyword) != 0 ||
+      (end < text.size() && (std::isalnum(static_cast<unsigned char>(text[end])) || text[end] == '_')))
+    return false;
+  position = end;
+  return true;
+}
+
+// n<digits>, empty if there is no name at `position`
+static std::string_view read_name(std::string_view text, size_t &position) {
+  size_t end = position + 1;
+  if (position >= text.size() || text[position] != 'n')
+    return {};
+  while (end < text.size() && is_digit(text[end]))
+    ++end;
+  if (end == position + 1)
+    return {};
+  const std::string_view name = text.substr(position, end - position);
+  position = end;
+  return name;
+}
+
+void Formula_Parser::fail(std::string_view text, size_t offset, std::string message) {
+  // The line is only computed here, the parser itself does not track it
+  const std::string_view before = text.substr(0, offset);
+  const size_t last_newline = before.rfind('\n');
+  failure.offset = offset;
+  failure.line = std::count(before.begin(), before.end(), '\n') + 1;
+  failure.column = last_newline == std::string_view::npos ? offset + 1 : offset - last_newline;
+  failure.message = std::move(message);
+}
+
+std::shared_ptr<Formula> Formula_Parser::parse_formula(std::string_view text,
+                                                       size_t &position) {
+  names.clear();
+  std::shared_ptr<Formula> result;
+  for (;;) {
+    skip_space(text, position);
+    if (!skip_word(text, position, "let")) {
+      result = parse_term(text, position);
+      break;
+    }
+    skip_space(text, position);
+    const size_t start = position;
+    const std::string_view name = read_name(text, position);
+    if (name.empty()) {
+      fail(text, start, "expected a name");
+      break;
+    }
+    skip_space(text, position);
+    if (position == text.size() || text[position] != '=') {
+      fail(text, position, "expected '='");
+      break;
+    }
+    ++position;
+    std::shared_ptr<Formula> definition = parse_term(text, position);
+    if (!definition)
+      break;
+    skip_space(text, position);
+    if (!skip_word(text, position, "in")) {
+      fail(text, position, "expected 'in'");
+      break;
+    }
+    if (!names.emplace(name, std::move(definition)).second) {
+      fail(text, start, "name defined twice");
+      break;
+    }
+  }
+  names.clear();
+  return result;
+}
+
+std::shared_ptr<Formula> Formula_Parser::parse_term(std::string_view text,
+                                                    size_t &position) {
+  frames.clear();
+  operands.clear();
+  for (;;) {
+    // a formula is expected, or the end of an empty list
+    skip_space(text, position);
+    if (position == text.size()) {
+      fail(text, position, "unexpected end of input, expected a formula");
+      return nullptr;
+    }
+    const size_t start = position;
+    const char c = text[position];
+    bool closes = false;
+    if (c == 'x') {
+      int literal = 0;
+      const char *first = text.data() + position + 1;
+      const auto [end, status] = std::from_chars(first, text.data() + text.size(), literal);
+      if (status != std::errc() || literal == 0) {
+        fail(text, position + 1,
+             status == std::errc::result_out_of_range ? "literal out of range"
+                                                      : "expected a non-zero literal");
+        return nullptr;
+      }
+      position = end - text.data();
+      operands.push_back(builder.make_variable(literal));
+    } else if (c == 'n') {
+      const std::string_view name = read_name(text, position);
+      const auto definition = names.find(name);
+      if (definition == names.end()) {
+        fail(text, start, name.empty() ? "expected a name" : "undefined name");
+        return nullptr;
+      }
+      operands.push_back(definition->second);
+    } else if (skip_keyword(text, position, "True")) {
+      operands.push_back(builder.make_true());
+    } else if (skip_keyword(text, position, "False")) {
+      operands.push_back(builder.make_false());
+    } else if (skip_keyword(text, position, "AND") || skip_keyword(text, position, "OR")) {
+      skip_space(text, position);
+      if (position == text.size() || text[position] != '[') {
+        fail(text, position, "expected '['");
+        return nullptr;
+      }
+      ++position;
+      frames.push_back({c == 'A', operands.size()});
+      skip_space(text, position);
+      if (position == text.size() || text[position] != ']')
+        continue; // first child
+      closes = true;
+    } else if (c == ']' && !frames.empty() && operands.size() > frames.back().first_operand) {
+      fail(text, start, "expected a formula after ','");
+      return nullptr;
+    } else {
+      fail(text, start, "expected a formula");
+      return nullptr;
+    }
+
+    // a formula is finished: close the gates it ends, or go to the next child
+    for (;;) {
+      if (closes) {
+        ++position; // ']'
+        const Frame frame = frames.back();
+        frames.pop_back();
+        std::vector<std::shared_ptr<Formula>> children(
+            std::make_move_iterator(operands.begin() + frame.first_operand),
+            std::make_move_iterator(operands.end()));
+        operands.resize(frame.first_operand);
+        operands.push_back(frame.conjunction ? builder.make_conjunction(std::move(children))
+                                             : builder.make_disjunction(std::move(children)));
+        closes = false;
+      }
+      if (frames.empty())
+        return std::move(operands.back());
+      skip_space(text, position);
+      if (position < text.size() && text[position] == ']') {
+        closes = true;
+        continue;
+      }
+      if (position < text.size() && text[position] == ',') {
+        ++position;
+        break;
+      }
+      fail(text, position,
+           position == text.size() ? "unexpected end of input, expected ',' or ']'"
+                                   : "expected ',' or ']'");
+      return nullptr;
+    }
+  }
+}
+
+std::shared_ptr<Formula> Formula_Parser::parse(std::string_view text) {
+  failure = Parse_Error();
+  size_t position = 0;
+  std::shared_ptr<Formula> result = parse_formula(text, position);
+  if (!result)
+    return nullptr;
+  skip_space(text, position);
+  if (position != text.size()) {
+    fail(text, position, "expected the end of input");
+    return nullptr;
+  }
+  return result;
+}
+
+std::vector<std::shared_ptr<Formula>> Formula_Parser::parse_all(std::string_view text) {
+  failure = Parse_Error();
+  std::vector<std::shared_ptr<Formula>> formulas;
+  size_t position = 0;
+  for (skip_space(text, position); position < text.size(); skip_space(text, position)) {
+    std::shared_ptr<Formula> f = parse_formula(text, position);
+    if (!f)
+      break;
+    formulas.push_back(std::move(f));
+  }
+  return formulas;
+}
+
+std::vector<std::shared_ptr<Formula>> Formula_Parser::parse_file(const std::string &path) {
+  const Mapped_File file(path);
+  if (!file.is_open()) {
+    failure = Parse_Error();
+    failure.message = file.error();
+    return {};
+  }
+  return parse_all(file.contents());
+}
@@ -0,0 +1,75 @@
+#ifndef FORMULA_PARSER_HPP
+#define FORMULA_PARSER_HPP
+
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class Logic_Node;
+class Logic_Builder;
+typedef Logic_Node Formula;
+
+// Position and reason of a parse failure. Lines and columns start at 1, the
+// column counts bytes.
+struct Parse_Error {
+  size_t offset = 0;
+  size_t line = 0;
+  size_t column = 0;
+  std::string message;
+};
+
+std::ostream &operator<<(std::ostream &stream, const Parse_Error &error);
+
+// Parser of the text printed by operator<< and print_formula on formulas:
+//
+//   formula := (let name = term in)* term
+//   term    := True | False | x<literal> | name | AND[list] | OR[list]
+//   list    := <empty> | term (, term)*
+//   name    := n<digits>
+//
+// with optional whitespace between the tokens. Names are local to their
+// formula and refer to the same node at every use. Formulas are built bottom-up
+// through the builder, so they are hash-consed if the builder is, and the
+// builder drops constant children as usual: the result is equivalent to the
+// text, not always identical. The input is scanned in place without
+// allocating per token, with an explicit stack for arbitrarily deep formulas.
+class Formula_Parser {
+public:
+  explicit Formula_Parser(Logic_Builder &builder) : builder(builder) {}
+
+  // Parses exactly one formula. Returns nullptr on failure, see error().
+  std::shared_ptr<Formula> parse(std::string_view text);
+  // Parses a sequence of formulas separated by whitespace, typically one per
+  // line. On failure, returns the formulas before the faulty one.
+  std::vector<std::shared_ptr<Formula>> parse_all(std::string_view text);
+  // parse_all over a memory-mapped file
+  std::vector<std::shared_ptr<Formula>> parse_file(const std::string &path);
+
+  bool failed() const { return !failure.message.empty(); }
+  const Parse_Error &error() const { return failure; }
+
+private:
+  Logic_Builder &builder;
+  Parse_Error failure;
+
+  // open gates and the finished formulas waiting for their parent
+  struct Frame {
+    bool conjunction;
+    size_t first_operand;
+  };
+  std::vector<Frame> frames;
+  std::vector<std::shared_ptr<Formula>> operands;
+  // let-bound names of the current formula, viewing the input
+  std::unordered_map<std::string_view, std::shared_ptr<Formula>> names;
+
+  // parse one formula or term starting at `position`, which is moved past it
+  std::shared_ptr<Formula> parse_formula(std::string_view text, size_t &position);
+  std::shared_ptr<Formula> parse_term(std::string_view text, size_t &position);
+  void fail(std::string_view text, size_t offset, std::string message);
+};
+
+#endif // FORMULA_PARSER_HPP
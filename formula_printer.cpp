@@ -0,0 +1,196 @@
+#include "formula_printer.hpp"
+#include "buffered_writer.hpp"
+#include "logic_node.hpp"
+#include "node_arena.hpp"
+#include "traversal.hpp"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// The printer is shared by Logic_Node and the handles of Node_Arena, which
+// differ in how constants, variables and children are read and in what
+// identifies a node.
+bool value_of(const Logic_Node &n) { return static_cast<const Constant &>(n).getValue(); }
+bool value_of(const Arena_Formula &n) { return n.getValue(); }
+int literal_of(const Logic_Node &n) { return static_cast<const Variable &>(n).getLiteral(); }
+int literal_of(const Arena_Formula &n) { return n.getLiteral(); }
+const Logic_Node *key_of(const Logic_Node &n) { return &n; }
+NodeId key_of(const Arena_Formula &n) { return n.getId(); }
+// handles are values, nodes are kept by address
+const Logic_Node *hold(const Logic_Node &n) { return &n; }
+Arena_Formula hold(const Arena_Formula &n) { return n; }
+const Logic_Node &held(const Logic_Node *n) { return *n; }
+const Arena_Formula &held(const Arena_Formula &n) { return n; }
+
+bool is_gate(const Logic_Node &n) { return n.isGate(); }
+bool is_gate(const Arena_Formula &n) {
+  return n.getKind() == Node_Kind::AND_GATE || n.getKind() == Node_Kind::OR_GATE;
+}
+size_t child_count(const Logic_Node &n) {
+  return static_cast<const Gate &>(n).getChildren().size();
+}
+size_t child_count(const Arena_Formula &n) { return n.arity(); }
+
+template <typename Callback> void for_each_child(const Logic_Node &n, Callback callback) {
+  for (const auto &child : static_cast<const Gate &>(n).getChildren())
+    callback(*child);
+}
+template <typename Callback> void for_each_child(const Arena_Formula &n, Callback callback) {
+  for (size_t i = 0; i < child_count(n); ++i)
+    callback(n.child(i));
+}
+
+// Prints gates on the way down and closes them on the way up. Named gates
+// other than the one being defined are printed as their name. Once the
+// length cap is reached nothing more is written and the walk unwinds.
+template <typename Node> struct Print_Visitor {
+  using Key = decltype(key_of(std::declval<const Node &>()));
+
+  Buffered_Writer &writer;
+  const Print_Options &options;
+  // name of the shared gates, empty without sharing
+  const std::unordered_map<Key, uint32_t> &names;
+  const Node *definition = nullptr;
+  size_t depth = 0;
+  bool truncated = false;
+
+  bool room() {
+    if (!truncated && writer.written() >= options.max_length)
+      truncated = true;
+    return !truncated;
+  }
+
+  bool enter(const Node &n) {
+    if (!room())
+      return false;
+    switch (n.getKind()) {
+    case Node_Kind::CONSTANT:
+      writer.write(value_of(n) ? "True" : "False");
+      return false;
+    case Node_Kind::VARIABLE:
+      writer.put('x');
+      writer.write_int(literal_of(n));
+      return false;
+    case Node_Kind::AND_GATE:
+    case Node_Kind::OR_GATE:
+      break;
+    }
+    if (!names.empty() && !(definition && key_of(n) == key_of(*definition))) {
+      const auto name = names.find(key_of(n));
+      if (name != names.end()) {
+        writer.put('n');
+        writer.write_int(name->second);
+        return false;
+      }
+    }
+    writer.write(n.getKind() == Node_Kind::AND_GATE ? "AND[" : "OR[");
+    if (depth >= options.max_depth) {
+      writer.write("...]");
+      return false;
+    }
+    ++depth;
+    return true;
+  }
+  bool child_done(const Node &parent, size_t i) {
+    if (!room())
+      return false;
+    if (i + 1 < child_count(parent))
+      writer.write(", ");
+    return true;
+  }
+  void leave(const Node &) {
+    --depth;
+    if (!truncated)
+      writer.put(']');
+  }
+};
+
+// The buffer is kept between prints of a thread, so that operator<< on a
+// small formula does not allocate it each time. A print started while another
+// one is running (from the stream) gets a buffer of its own.
+class Print_Buffer {
+public:
+  static constexpr size_t capacity = 1 << 16;
+
+  Print_Buffer() : owner(!in_use) {
+    if (!owner || !shared)
+      (owner ? shared : own) = std::make_unique_for_overwrite<char[]>(capacity);
+    in_use = true;
+  }
+  ~Print_Buffer() {
+    if (owner)
+      in_use = false;
+  }
+  Print_Buffer(const Print_Buffer &) = delete;
+  Print_Buffer &operator=(const Print_Buffer &) = delete;
+
+  char *data() const { return owner ? shared.get() : own.get(); }
+
+private:
+  static inline thread_local std::unique_ptr<char[]> shared;
+  static inline thread_local bool in_use = false;
+  const bool owner;
+  std::unique_ptr<char[]> own;
+};
+
+template <typename Node>
+void print_dag(std::ostream &out, const Node &f, const Print_Options &options) {
+  using Key = typename Print_Visitor<Node>::Key;
+  Print_Buffer buffer;
+  Buffered_Writer writer(out, buffer.data(), Print_Buffer::capacity);
+  std::unordered_map<Key, uint32_t> names;
+  Print_Visitor<Node> printer{writer, options, names};
+
+  if (options.share) {
+    // Gates reached from two parents or more are named. They are defined in
+    // post-order, so a definition only refers to names defined before it.
+    std::unordered_map<Key, uint32_t> parents;
+    for_each_node(f, Visit_Order::PRE_ORDER, [&parents](const Node &n) {
+      if (is_gate(n)) {
+        for_each_child(n, [&parents](const Node &child) {
+          if (is_gate(child))
+            ++parents[key_of(child)];
+        });
+      }
+    });
+    std::vector<decltype(hold(f))> shared;
+    for_each_node(f, Visit_Order::POST_ORDER, [&](const Node &n) {
+      const auto count = parents.find(key_of(n));
+      if (count != parents.end() && count->second >= 2)
+        shared.push_back(hold(n));
+    });
+
+    for (const auto &gate : shared) {
+      const Node &n = held(gate);
+      if (!printer.room())
+        break;
+      names.emplace(key_of(n), names.size() + 1);
+      writer.write("let n");
+      writer.write_int(names.size());
+      writer.write(" = ");
+      printer.definition = &n;
+      walk_formula(n, printer);
+      if (!printer.truncated)
+        writer.write(" in ");
+    }
+    printer.definition = nullptr;
+  }
+  walk_formula(f, printer);
+  if (printer.truncated)
+    writer.write("...");
+  writer.flush();
+}
+
+} // namespace
+
+void print_formula(std::ostream &out, const Formula &f, const Print_Options &options) {
+  print_dag(out, f, options);
+}
+
+void print_formula(std::ostream &out, const Arena_Formula &f,
+                   const Print_Options &options) {
+  print_dag(out, f, options);
+}
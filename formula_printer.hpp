@@ -0,0 +1,47 @@
+#ifndef FORMULA_PRINTER_HPP
+#define FORMULA_PRINTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+class Logic_Node;
+class Arena_Formula;
+typedef Logic_Node Formula;
+
+struct Print_Options {
+  // Names every gate with several parents once, in post-order, and refers to
+  // it by name afterwards:
+  //   let n1 = OR[x1, x2] in let n2 = AND[n1, x3] in OR[n2, AND[n1, x4]]
+  // The output is then linear in the size of the DAG instead of the tree.
+  bool share = true;
+  // gates below this depth are printed as AND[...], per definition with share
+  size_t max_depth = SIZE_MAX;
+  // the output stops with "..." once it has reached about this many characters
+  size_t max_length = SIZE_MAX;
+};
+
+// Prints `f` in the text format read by Formula_Parser, through a large
+// buffer instead of one stream operation per token. Without sharing and caps
+// the output is the one of operator<<.
+void print_formula(std::ostream &out, const Formula &f, const Print_Options &options = {});
+// same output for the arena form of `f`
+void print_formula(std::ostream &out, const Arena_Formula &f,
+                   const Print_Options &options = {});
+
+// Formatting through a stream: std::cout << formula_text(*f, {.max_length = 200})
+struct Formula_Text {
+  const Formula &formula;
+  Print_Options options;
+};
+
+inline Formula_Text formula_text(const Formula &f, const Print_Options &options = {}) {
+  return {f, options};
+}
+
+inline std::ostream &operator<<(std::ostream &stream, const Formula_Text &text) {
+  print_formula(stream, text.formula, text.options);
+  return stream;
+}
+
+#endif // FORMULA_PRINTER_HPP
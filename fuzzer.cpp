@@ -1,15 +1,44 @@
 #include "fuzzer.hpp"
+#include "formula_printer.hpp"
+#include "instrumentation.hpp"
 #include "logic_builder.hpp"
 #include "logic_node.hpp"
+#include "logic_program.hpp"
 #include "random.hpp"
+#include "simplifier_cache.hpp"
+#include "traversal.hpp"
+#include "tseitin.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <thread>
+
+Fuzzer::Fuzzer(uint64_t seed, int size, int len, Fuzzer_Options options)
+    : rand(seed), number_of_literals(size), options(options), length(len) {
+  // A private cache keeps the run of a fuzzer independent of other fuzzers
+  // of the process, so that each run can be replayed on its own.
+  builder.set_cache_scope(Cache_Scope::BUILDER);
+  std::vector<int> order;
+  for (int i = 1; i <= number_of_literals; ++i)
+    order.push_back(i);
+  bdd.set_order(order);
+}
+
+// Verbose traces print one capped line per formula. Error reports print the
+// whole formula, in the shared form that Formula_Parser reads back.
+static const Print_Options verbose_print{.max_depth = 16, .max_length = 4096};
 
 // abort and print the current seed
 void Fuzzer::abort_err() {
   std::cerr << "\nERROR, rerun with the following seed as start point "
             << current_loop_seed << "\n";
+  instrumentation::count(Counter::FUZZ_ERRORS);
+  if (!found_errors)
+    first_failing_seed = current_loop_seed;
   ++found_errors;
   error_in_last_round = true;
   if (fail_on_first_error)
@@ -31,32 +60,137 @@ std::vector<std::shared_ptr<Formula>> Fuzzer::pick_children() {
   return children;
 }
 
-void Fuzzer::generate_model(std::vector<bool> &model) {
-  model.clear ();
+// generates 64 * words random models at once in the transposed layout of
+// Logic_Builder::evaluate_wide
+void Fuzzer::generate_models(std::vector<uint64_t> &models, size_t words) {
+  models.clear ();
   for (int i = 0; i <= number_of_literals; ++i) {
-    const bool positive = rand.generate_bool();
-    model.push_back(positive);
+    for (size_t w = 0; w < words; ++w) {
+      const uint64_t low = rand.generate();
+      const uint64_t high = rand.generate();
+      models.push_back((high << 32) | low);
+    }
+  }
+}
+
+void Fuzzer::report_different_models(const std::shared_ptr<Formula> &f1,
+                                     const std::shared_ptr<Formula> &f2,
+                                     const std::vector<bool> &model) {
+  std::cerr << "the models are not the same (val: " << builder.evaluate(f1, model) << ")\n\t"
+            << formula_text(*f1) << "\nvs (val: " << builder.evaluate(f2, model) << ")\n\t"
+            << formula_text(*f2) << "\n";
+  std::cerr << "model: ";
+  for (size_t i = 0; i < model.size (); ++i)
+    std::cerr << (model[i] ? 1 : -1) * static_cast<int>(i + 1) << " ";
+  std::cerr << "\n";
+  abort_err();
+}
+
+// Bit j of model m is bit j of m, for the first 6 variables of a truth table
+static const uint64_t truth_table_patterns[6] = {
+    0xAAAAAAAAAAAAAAAAull, 0xCCCCCCCCCCCCCCCCull, 0xF0F0F0F0F0F0F0F0ull,
+    0xFF00FF00FF00FF00ull, 0xFFFF0000FFFF0000ull, 0xFFFFFFFF00000000ull};
+
+bool Fuzzer::test_truth_tables(const std::shared_ptr<Formula> &f1,
+                               const std::shared_ptr<Formula> &f2) {
+  // variables occurring in either formula, as indices into the model
+  std::vector<bool> occurs(number_of_literals + 1);
+  std::vector<size_t> support;
+  auto add_support = [&](const Formula &n) {
+    const Variable *variable = as_variable(n);
+    if (!variable)
+      return;
+    const size_t index = std::abs(variable->getLiteral()) - 1;
+    if (index >= occurs.size())
+      occurs.resize(index + 1);
+    if (!occurs[index]) {
+      occurs[index] = true;
+      support.push_back(index);
+    }
+  };
+  for_each_node(*f1, Visit_Order::PRE_ORDER, add_support);
+  for_each_node(*f2, Visit_Order::PRE_ORDER, add_support);
+  if (support.size() > options.exhaustive_support_limit)
+    return false;
+
+  // Every assignment of the support is one model: variable j of the support
+  // takes bit j of the model number, the other variables are false.
+  const size_t models = size_t(1) << support.size();
+  const size_t words = (models + 63) / 64;
+  std::vector<uint64_t> inputs(occurs.size() * words, 0);
+  for (size_t j = 0; j < support.size(); ++j) {
+    uint64_t *row = inputs.data() + support[j] * words;
+    for (size_t w = 0; w < words; ++w)
+      row[w] = j < 6 ? truth_table_patterns[j] : ((w >> (j - 6)) & 1 ? ~uint64_t(0) : 0);
+  }
+
+  const std::vector<uint64_t> v1 = builder.evaluate_wide(f1, inputs, words);
+  const std::vector<uint64_t> v2 = builder.evaluate_wide(f2, inputs, words);
+  const uint64_t mask = models >= 64 ? ~uint64_t(0) : (uint64_t(1) << models) - 1;
+  bool same = true;
+  uint64_t count = 0;
+  for (size_t w = 0; w < words; ++w) {
+    count += std::popcount(v1[w] & mask);
+    if (const uint64_t diff = (v1[w] ^ v2[w]) & mask; diff && same) {
+      report_different_models(
+          f1, f2, Logic_Builder::unpack_model(inputs, 64 * w + std::countr_zero(diff), words));
+      same = false;
+    }
   }
+  // the truth tables are a proof already, the SAT miter is left to larger
+  // supports, see test_same_models
+  test_bdd(f1, f2, same, count << (bdd.variables() - support.size()));
+  return true;
+}
+
+// the BDDs must agree with the truth tables on equivalence and model count
+void Fuzzer::test_bdd(const std::shared_ptr<Formula> &f1, const std::shared_ptr<Formula> &f2,
+                      bool equivalent, uint64_t models_of_f1) {
+  const BddId b1 = bdd.from_formula(*f1);
+  const BddId b2 = bdd.from_formula(*f2);
+  if ((b1 == b2) != equivalent) {
+    std::cerr << "the BDDs " << (equivalent ? "differ" : "are equal") << " for\n\t"
+              << formula_text(*f1) << "\nvs\n\t" << formula_text(*f2) << "\n";
+    abort_err();
+  }
+  if (bdd.model_count(b1) != models_of_f1) {
+    std::cerr << "the BDD counts " << bdd.model_count(b1) << " models instead of "
+              << models_of_f1 << " for\n\t" << formula_text(*f1) << "\n";
+    abort_err();
+  }
+  // nothing needs to survive the check
+  if (bdd.size() > (1u << 20))
+    bdd.collect_garbage({});
 }
 
 void Fuzzer::test_same_models (std::shared_ptr<Formula> f1, std::shared_ptr<Formula> f2) {
+  // complete check if the truth tables are small enough, sampling and SAT otherwise
+  if (test_truth_tables(f1, f2))
+    return;
   const int n = rand.pick_int(0, 10000);
-  std::vector<bool> model;
-  for (int i = 0; i < n; ++i) {
-    generate_model (model);
-    const bool v1 = builder.evaluate(f1, model);
-    const bool v2 = builder.evaluate(f2, model);
-    if (v1 != v2) {
-      std::cerr << "the models are not the same (val: " << v1 << ")\n\t" << *f1
-                 << "\nvs (val: " << v2 << ")\n\t" << *f2 << "\n";
-      std::cerr << "model: ";
-      for (size_t i = 1; i < model.size (); ++i)
-	std::cerr << (model[i] ? i : -i) << " ";
-      std::cerr << "\n";
-      abort_err();
-      break;
+  const size_t words = (n + 63) / 64;
+  std::vector<uint64_t> models;
+  generate_models (models, words);
+  const std::vector<uint64_t> v1 = builder.evaluate_wide(f1, models, words);
+  const std::vector<uint64_t> v2 = builder.evaluate_wide(f2, models, words);
+  for (size_t w = 0; w < words; ++w) {
+    const int batch = std::min(64, n - static_cast<int>(64 * w));
+    const uint64_t mask = batch == 64 ? ~uint64_t(0) : (uint64_t(1) << batch) - 1;
+    if (const uint64_t diff = (v1[w] ^ v2[w]) & mask) {
+      const unsigned bit = std::countr_zero(diff);
+      report_different_models(f1, f2, Logic_Builder::unpack_model(models, 64 * w + bit, words));
+      return;
     }
-    model.clear ();
+  }
+  // sampling misses rare differences, the miter finds them
+  Equivalence_Check check = sat_equivalence(*f1, *f2, options.sat_conflict_limit);
+  if (check.verdict == Equivalence::UNKNOWN) {
+    instrumentation::count(Counter::FUZZ_SAT_UNKNOWN);
+    ++unknown_sat_checks;
+  }
+  if (check.verdict == Equivalence::DIFFERENT) {
+    check.counterexample.resize(number_of_literals);
+    report_different_models(f1, f2, check.counterexample);
   }
 }
 
@@ -115,21 +249,21 @@ void Fuzzer::test_simplify ([[maybe_unused]] bool verbose) {
     std::cout << "*****************\ntest simplify" << "\n";
   auto simplified = builder.simplify(orig);
   if (verbose)
-    std::cout << "test simplify\t" << *orig << "\nafter simplification\t"
-              << *simplified << "\n";
+    std::cout << "test simplify\t" << formula_text(*orig, verbose_print)
+              << "\nafter simplification\t" << formula_text(*simplified, verbose_print) << "\n";
 
   // First, test that the simplified formula is semantically equivalent to the original
   test_same_models(simplified, orig);
   
   // Only perform structural checks on gates, not on constants or variables
-  auto gate = std::dynamic_pointer_cast<Gate>(simplified);
+  const Gate *gate = as_gate(*simplified);
   if (gate) {
     const auto& direct_children = gate->getChildren();
     
     // Check for constants in direct children of AND/OR gates
     // Constants should have been simplified away according to the rules
     for (const auto& child : direct_children) {
-      if (std::dynamic_pointer_cast<Constant>(child)) {
+      if (child->getKind() == Node_Kind::CONSTANT) {
         if (verbose)
           std::cout << "Error: Found constant in direct children of simplified formula" << std::endl;
         abort_err();
@@ -152,6 +286,48 @@ void Fuzzer::test_simplify ([[maybe_unused]] bool verbose) {
   cache.push_back(simplified);
 }
 
+// checks the compiled program, the memoized evaluation and the arena backend
+// against the plain evaluation of the formula
+void Fuzzer::test_evaluators ([[maybe_unused]] bool verbose) {
+  if (verbose)
+    std::cout << "test evaluators\n";
+  const int pos = rand.pick_int(0, cache.size() - 1);
+  auto orig = cache [pos];
+  const Logic_Program program = builder.compile(orig);
+
+  std::vector<uint64_t> models;
+  generate_models (models, 1);
+  const uint64_t expected = builder.evaluate_batch(orig, models);
+  if (program.evaluate_batch(models) != expected) {
+    std::cerr << "the compiled program differs in batch evaluation\n\t" << formula_text(*orig)
+              << "\n";
+    abort_err();
+    return;
+  }
+  const NodeId imported = builder.arena().import(*orig);
+  if (builder.arena().evaluate_batch(imported, models) != expected) {
+    std::cerr << "the arena formula differs in batch evaluation\n\t" << formula_text(*orig)
+              << "\nvs\n\t" << Arena_Formula(builder.arena(), imported) << "\n";
+    abort_err();
+    return;
+  }
+  for (unsigned index = 0; index < 64; ++index) {
+    const std::vector<bool> model = Logic_Builder::unpack_model(models, index);
+    if (program.evaluate(model) != bool((expected >> index) & 1)) {
+      std::cerr << "the compiled program differs on model " << index << "\n\t"
+                << formula_text(*orig) << "\n";
+      abort_err();
+      return;
+    }
+    if (builder.evaluate_memoized(*orig, model) != bool((expected >> index) & 1)) {
+      std::cerr << "the memoized evaluation differs on model " << index << "\n\t"
+                << formula_text(*orig) << "\n";
+      abort_err();
+      return;
+    }
+  }
+}
+
 void Fuzzer::prepopulate () {
   for (int i = 0; i < 10; ++i) {
 
@@ -177,45 +353,121 @@ void Fuzzer::prepopulate () {
   }
 }
 
+void Fuzzer::restart_loop() {
+  current_loop_seed = rand.seed();
+  prepopulate();
+  builder.clear_cache();
+  builder.arena().clear();
+  // also exercise the bounded cache, with budgets small enough to evict
+  const int policy = rand.pick_int(0, 2);
+  builder.cache().set_memory_budget(rand.pick_int(16, 256) * 1024,
+                                    static_cast<Eviction_Policy>(policy));
+}
+
 void Fuzzer::run([[maybe_unused]] bool verbose) {
 
   // first populate the cache with some value
-  prepopulate();
+  restart_loop();
 
   // now test
   for (int i = 0; i < length; ++i) {
-    if (!(i % 100))
+    if (show_progress && !(i % 100))
       std::cout << "..." << i;
 
-    const int n = rand.pick_int(0, 3);
+    const int n = rand.pick_int(0, 4);
+    instrumentation::count(Counter::FUZZ_ROUNDS);
 
     switch (n) {
-    case 0:
+    case 0: {
+      instrumentation::Scoped_Timer timer(Timer::FUZZ_PRODUCE);
       produce_new_node(verbose);
       break;
-    case 1:
+    }
+    case 1: {
+      instrumentation::Scoped_Timer timer(Timer::FUZZ_NORMALIZE);
       test_normalize(verbose);
       break;
-    case 2:
+    }
+    case 2: {
+      instrumentation::Scoped_Timer timer(Timer::FUZZ_SIMPLIFY);
       test_simplify (verbose);
       break;
+    }
+    case 3: {
+      instrumentation::Scoped_Timer timer(Timer::FUZZ_EVALUATORS);
+      test_evaluators (verbose);
+      break;
+    }
     default:
       if (rand.pick_int(0,100) < 10) {
 	if (verbose)
 	  std::cout << "emptying cache";
 	cache.clear ();
-	current_loop_seed = rand.seed();
-	prepopulate();
-	builder.clear_cache();
+	restart_loop();
       }
       break;
     }
 
     if (error_in_last_round) {
       error_in_last_round = false;
+      if (stop_on_first_error)
+        break;
     }
   }
-  if (!fail_on_first_error) {
+  if (!fail_on_first_error && !stop_on_first_error) {
     std::cout << "\n\nerrors: " << found_errors << " from " << length << "\n";
   }
+  if (unknown_sat_checks && !stop_on_first_error) {
+    std::cout << "\n" << unknown_sat_checks << " SAT checks gave up after "
+              << options.sat_conflict_limit << " conflicts\n";
+  }
+}
+
+uint64_t Fuzzer::worker_seed(uint64_t seed, unsigned worker) {
+  // splitmix64 of the start seed and the worker index: nearby start seeds and
+  // workers get unrelated streams
+  uint64_t z = seed + (uint64_t(worker) + 1) * 0x9e3779b97f4a7c15ull;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+unsigned Fuzzer::run_parallel(uint64_t seed, int size, int len, unsigned jobs,
+                              bool verbose, Fuzzer_Options options) {
+  assert(jobs > 0);
+  std::vector<std::unique_ptr<Fuzzer>> workers;
+  for (unsigned k = 0; k < jobs; ++k) {
+    // split the tests evenly, the first workers take the remainder
+    const unsigned tests = len > 0 ? len : 0;
+    const int share = tests / jobs + (k < tests % jobs ? 1 : 0);
+    workers.push_back(std::make_unique<Fuzzer>(worker_seed(seed, k), size, share, options));
+    workers.back()->fail_on_first_error = false;
+    workers.back()->stop_on_first_error = true;
+    workers.back()->show_progress = false;
+  }
+
+  std::vector<std::thread> threads;
+  for (auto &worker : workers) {
+    threads.emplace_back([&worker, verbose]() { worker->run(verbose); });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  unsigned failed = 0;
+  uint64_t unknowns = 0;
+  for (unsigned k = 0; k < jobs; ++k) {
+    unknowns += workers[k]->sat_unknowns();
+    if (!workers[k]->errors())
+      continue;
+    ++failed;
+    std::cerr << "worker " << k << " (seed " << worker_seed(seed, k)
+              << ") failed, replay with the seed " << workers[k]->failing_seed()
+              << "\n";
+  }
+  std::cout << "\n\n" << jobs << " workers, " << failed << " failed\n";
+  if (unknowns)
+    std::cout << unknowns << " SAT checks gave up after " << options.sat_conflict_limit
+              << " conflicts\n";
+  return failed;
 }
@@ -2,6 +2,7 @@
 #define FUZZER_HPP
 
 // TODO: if did not follow the template, this might not be the right file name
+#include "bdd.hpp"
 #include "logic_builder.hpp"
 
 #include "random.hpp"
@@ -12,48 +13,98 @@
 
 struct Clause;
 
+// Settings of the checks, the same for every loop and every worker
+struct Fuzzer_Options {
+  // largest support checked exhaustively, 2^20 models are 16384 words per
+  // variable. Larger supports are sampled, then checked by SAT.
+  size_t exhaustive_support_limit = 20;
+  // the SAT check of larger supports gives up after that many conflicts, see
+  // Fuzzer::sat_unknowns
+  int64_t sat_conflict_limit = 100000;
+};
+
 class Fuzzer {
 public:
   // Constructor with 3 arguments: the seed, the number of literals to use and
   // the number of tests to run.
-  Fuzzer(uint64_t seed, int size, int len)
-      : rand(seed), number_of_literals(size), length(len) {}
+  Fuzzer(uint64_t seed, int size, int len, Fuzzer_Options options = {});
 
   void run(bool verbose);
 
+  // Parallel mode: `jobs` workers each run an independent fuzzer for their
+  // share of `len` tests, seeded by worker_seed(seed, worker). A failing
+  // worker stops and reports the seed of its current loop, which replays the
+  // failure single-threaded. Returns the number of failing workers.
+  static unsigned run_parallel(uint64_t seed, int size, int len, unsigned jobs,
+                               bool verbose, Fuzzer_Options options = {});
+  // Seed of each worker, derived deterministically from the start seed
+  static uint64_t worker_seed(uint64_t seed, unsigned worker);
+
+  uint64_t errors() const { return found_errors; }
+  // counts the errors and goes on instead of aborting at the first one
+  void keep_going() { fail_on_first_error = false; }
+  // seed of the loop in which the first error was found
+  uint64_t failing_seed() const { return first_failing_seed; }
+  // SAT checks that gave up, the formulas compared by them are not proven
+  // equivalent
+  uint64_t sat_unknowns() const { return unknown_sat_checks; }
+
 protected:
   void produce_new_node(bool);
   std::vector<std::shared_ptr<Formula>> pick_children();
   void test_normalize(bool);
   void test_simplify(bool);
+  void test_evaluators(bool);
   void test_same_models(std::shared_ptr<Formula>, std::shared_ptr<Formula>);
-  void generate_model(std::vector<bool> &model);
+  // Compares the full truth tables over the variables occurring in either
+  // formula. Returns false without checking if there are more than
+  // `options.exhaustive_support_limit` of them.
+  bool test_truth_tables(const std::shared_ptr<Formula> &,
+                         const std::shared_ptr<Formula> &);
+  void test_bdd(const std::shared_ptr<Formula> &, const std::shared_ptr<Formula> &,
+                bool equivalent, uint64_t models_of_f1);
+  void report_different_models(const std::shared_ptr<Formula> &,
+                               const std::shared_ptr<Formula> &,
+                               const std::vector<bool> &model);
+  void generate_models(std::vector<uint64_t> &models, size_t words);
   void prepopulate();
+  // starts a new loop: fresh formulas, empty caches and a random cache budget
+  void restart_loop();
 
 private:
   // deterministic random generator
   Random rand;
 
   Logic_Builder builder;
+  // order of the variables 1 to number_of_literals
+  Bdd_Manager bdd;
 
   // highest literal to produce in formulas. This is the maximum and is
   // *reached*. It is not a size.
   int number_of_literals = 100;
 
+  Fuzzer_Options options;
+
   // number of tests to execute
   int length = 0;
 
   // seed of the current loop to be able to restart the search directly at that
   // point
-  uint64_t current_loop_seed;
+  uint64_t current_loop_seed = 0;
+  uint64_t first_failing_seed = 0;
 
   // prints the same string to make it easier to identify which test failed.
   // Used at each test beginning with the second argument __LINE__ to give
   // precise feedback.
   void print_banner(const std::string &, int);
   uint64_t found_errors = 0;
+  uint64_t unknown_sat_checks = 0;
   bool fail_on_first_error = true;
   bool error_in_last_round = false;
+  // in parallel mode, workers return after their first error instead of
+  // aborting the process, and do not print their progress
+  bool stop_on_first_error = false;
+  bool show_progress = true;
 
   // abort and prints the current seed
   void abort_err();
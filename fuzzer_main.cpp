@@ -1,8 +1,11 @@
 #include "fuzzer.hpp"
+#include "instrumentation.hpp"
 #include "random.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <time.h>
 
 // Convert the RZ account to a proper seed
@@ -34,7 +37,62 @@ uint64_t int_of_rz_account(std::string rz) {
 //   - in all other cases, it just generates a seed based on the time
 //
 // Except for 2 options, we assume that the seed is a number.
+//
+// Any of them can be combined with `-j N` to split the tests over N parallel
+// workers (`-j 0` for one per core). Each worker has its own seed derived from
+// the starting seed, and failing workers print a seed that replays the
+// failure with one thread.
+//
+// `--stats` prints the counters and timers of the run as JSON at the end.
+//
+// `--exhaustive-limit N` compares the truth tables of formulas over at most N
+// variables (20 by default), and larger ones by sampling and SAT. With the 20
+// literals of the fuzzer, a lower limit is needed to run the SAT checks.
+// `--sat-conflict-limit N` sets the conflicts after which a SAT check gives
+// up (100000 by default, negative for none); the checks that gave up are
+// counted and printed at the end.
 int main(int argc, char **argv) {
+  bool stats = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) != "--stats")
+      continue;
+    stats = true;
+    for (int j = i; j + 1 <= argc; ++j)
+      argv[j] = argv[j + 1];
+    argc -= 1;
+    break;
+  }
+
+  unsigned jobs = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) != "-j" || i + 1 == argc)
+      continue;
+    jobs = static_cast<unsigned>(std::stoul(argv[i + 1]));
+    if (!jobs)
+      jobs = std::max(1u, std::thread::hardware_concurrency());
+    // drop the option, the other arguments are positional
+    for (int j = i; j + 2 <= argc; ++j)
+      argv[j] = argv[j + 2];
+    argc -= 2;
+    break;
+  }
+
+  Fuzzer_Options options;
+  for (int i = 1; i + 1 < argc;) {
+    const std::string option = argv[i];
+    if (option == "--exhaustive-limit")
+      options.exhaustive_support_limit = std::stoul(argv[i + 1]);
+    else if (option == "--sat-conflict-limit")
+      options.sat_conflict_limit = std::stoll(argv[i + 1]);
+    else {
+      ++i;
+      continue;
+    }
+    for (int j = i; j + 2 <= argc; ++j)
+      argv[j] = argv[j + 2];
+    argc -= 2;
+  }
+
   uint64_t seed;
   int length = 1001;
   bool verbose = false;
@@ -61,7 +119,15 @@ int main(int argc, char **argv) {
     std::cout << "using as seed! " << seed << "\n";
   }
   std::cout << "testing " << length - 1 << " values\n";
-  Fuzzer fuzz(seed, 20, length);
-  fuzz.run(verbose);
-  return 0;
+  int status = 0;
+  if (jobs > 1) {
+    std::cout << "with " << jobs << " workers\n";
+    status = Fuzzer::run_parallel(seed, 20, length, jobs, verbose, options) ? 1 : 0;
+  } else {
+    Fuzzer fuzz(seed, 20, length, options);
+    fuzz.run(verbose);
+  }
+  if (stats)
+    std::cout << instrumentation::snapshot().json() << "\n";
+  return status;
 }
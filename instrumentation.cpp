@@ -0,0 +1,117 @@
+#include "instrumentation.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+// Blocks of the live threads, and the totals of the threads that exited
+struct Registry {
+  std::mutex mutex;
+  std::vector<instrumentation_detail::Thread_Block *> blocks;
+  Instrumentation_Snapshot retired;
+};
+
+// Constructed by the first block, hence destroyed after the last one
+Registry &registry() {
+  static Registry instance;
+  return instance;
+}
+
+void accumulate(Instrumentation_Snapshot &totals,
+                const instrumentation_detail::Thread_Block &block) {
+  for (size_t c = 0; c < counter_count; ++c)
+    totals.counters[c] += block.counters[c].load(std::memory_order_relaxed);
+  for (size_t t = 0; t < timer_count; ++t) {
+    Timer_Statistics &timer = totals.timers[t];
+    timer.calls += block.calls[t].load(std::memory_order_relaxed);
+    timer.total_ns += block.total_ns[t].load(std::memory_order_relaxed);
+    timer.max_ns = std::max(timer.max_ns, block.max_ns[t].load(std::memory_order_relaxed));
+  }
+}
+
+constexpr const char *counter_names[counter_count] = {
+    "nodes_allocated",
+    "unique_table_hits",
+    "simplify_cache_lookups",
+    "simplify_cache_hits",
+    "normalize_duplicates_removed",
+    "normalize_constants_removed",
+    "fuzz_rounds",
+    "fuzz_errors",
+    "fuzz_sat_unknown",
+};
+
+constexpr const char *timer_names[timer_count] = {
+    "simplify",       "normalize",      "evaluate",        "fuzz_produce",
+    "fuzz_normalize", "fuzz_simplify",  "fuzz_evaluators",
+};
+
+} // namespace
+
+instrumentation_detail::Thread_Block::Thread_Block() {
+  Registry &r = registry();
+  std::lock_guard lock(r.mutex);
+  r.blocks.push_back(this);
+}
+
+instrumentation_detail::Thread_Block::~Thread_Block() {
+  Registry &r = registry();
+  std::lock_guard lock(r.mutex);
+  accumulate(r.retired, *this);
+  r.blocks.erase(std::find(r.blocks.begin(), r.blocks.end(), this));
+}
+
+const char *instrumentation::name(Counter c) {
+  return counter_names[static_cast<size_t>(c)];
+}
+
+const char *instrumentation::name(Timer t) {
+  return timer_names[static_cast<size_t>(t)];
+}
+
+Instrumentation_Snapshot instrumentation::snapshot() {
+  Registry &r = registry();
+  std::lock_guard lock(r.mutex);
+  Instrumentation_Snapshot totals = r.retired;
+  for (const auto *block : r.blocks)
+    accumulate(totals, *block);
+  return totals;
+}
+
+void instrumentation::reset() {
+  Registry &r = registry();
+  std::lock_guard lock(r.mutex);
+  r.retired = Instrumentation_Snapshot();
+  for (auto *block : r.blocks) {
+    for (auto &value : block->counters)
+      value.store(0, std::memory_order_relaxed);
+    for (size_t t = 0; t < timer_count; ++t) {
+      block->calls[t].store(0, std::memory_order_relaxed);
+      block->total_ns[t].store(0, std::memory_order_relaxed);
+      block->max_ns[t].store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+void Instrumentation_Snapshot::write_json(std::ostream &out) const {
+  out << "{\"enabled\": " << (instrumentation::enabled ? "true" : "false")
+      << ", \"counters\": {";
+  for (size_t c = 0; c < counter_count; ++c)
+    out << (c ? ", \"" : "\"") << counter_names[c] << "\": " << counters[c];
+  out << "}, \"timers\": {";
+  for (size_t t = 0; t < timer_count; ++t) {
+    out << (t ? ", \"" : "\"") << timer_names[t] << "\": {\"calls\": " << timers[t].calls
+        << ", \"total_ns\": " << timers[t].total_ns << ", \"max_ns\": " << timers[t].max_ns
+        << "}";
+  }
+  out << "}}";
+}
+
+std::string Instrumentation_Snapshot::json() const {
+  std::ostringstream out;
+  write_json(out);
+  return out.str();
+}
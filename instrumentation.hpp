@@ -0,0 +1,147 @@
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Counters and timers of the builder and the fuzzer
+//
+// Every thread updates a block of its own with plain relaxed stores, so
+// instrumented code never contends on a shared cache line. snapshot() sums
+// the blocks of the live threads and those of the threads that have exited.
+// Built with LOGIC_STATS=0, count and Scoped_Timer are empty inline
+// functions and nothing is recorded.
+#ifndef LOGIC_STATS
+#define LOGIC_STATS 1
+#endif
+
+enum class Counter : unsigned {
+  NODES_ALLOCATED,              // nodes created by the make_* functions
+  UNIQUE_TABLE_HITS,            // make_* calls answered by the hash-consing tables
+  SIMPLIFY_CACHE_LOOKUPS,       // simplified_representative lookups
+  SIMPLIFY_CACHE_HITS,
+  NORMALIZE_DUPLICATES_REMOVED, // children dropped by normalize as duplicates
+  NORMALIZE_CONSTANTS_REMOVED,  // children dropped or absorbed as constants
+  FUZZ_ROUNDS,
+  FUZZ_ERRORS,
+  FUZZ_SAT_UNKNOWN,             // SAT checks of the fuzzer stopped by the conflict limit
+  COUNT
+};
+
+enum class Timer : unsigned {
+  SIMPLIFY,
+  NORMALIZE,
+  EVALUATE,
+  FUZZ_PRODUCE,
+  FUZZ_NORMALIZE,
+  FUZZ_SIMPLIFY,
+  FUZZ_EVALUATORS,
+  COUNT
+};
+
+constexpr size_t counter_count = static_cast<size_t>(Counter::COUNT);
+constexpr size_t timer_count = static_cast<size_t>(Timer::COUNT);
+
+struct Timer_Statistics {
+  uint64_t calls = 0;
+  uint64_t total_ns = 0;
+  uint64_t max_ns = 0;
+};
+
+struct Instrumentation_Snapshot {
+  std::array<uint64_t, counter_count> counters{};
+  std::array<Timer_Statistics, timer_count> timers{};
+
+  uint64_t counter(Counter c) const { return counters[static_cast<size_t>(c)]; }
+  const Timer_Statistics &timer(Timer t) const { return timers[static_cast<size_t>(t)]; }
+
+  // {"enabled": true, "counters": {"nodes_allocated": 12, ...},
+  //  "timers": {"simplify": {"calls": 3, "total_ns": 5120, "max_ns": 2900}, ...}}
+  void write_json(std::ostream &out) const;
+  std::string json() const;
+};
+
+namespace instrumentation {
+
+constexpr bool enabled = LOGIC_STATS;
+
+const char *name(Counter c);
+const char *name(Timer t);
+
+// totals over every thread of the process
+Instrumentation_Snapshot snapshot();
+// Zeroes every total. Updates made by other threads during the reset may be
+// lost or kept.
+void reset();
+
+} // namespace instrumentation
+
+namespace instrumentation_detail {
+
+struct Thread_Block {
+  std::array<std::atomic<uint64_t>, counter_count> counters{};
+  std::array<std::atomic<uint64_t>, timer_count> calls{};
+  std::array<std::atomic<uint64_t>, timer_count> total_ns{};
+  std::array<std::atomic<uint64_t>, timer_count> max_ns{};
+
+  // registered while the thread lives, merged into the totals at exit
+  Thread_Block();
+  ~Thread_Block();
+};
+
+inline Thread_Block &thread_block() {
+  thread_local Thread_Block block;
+  return block;
+}
+
+// only the owning thread writes, hence no read-modify-write is needed
+inline void add(std::atomic<uint64_t> &value, uint64_t n) {
+  value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+} // namespace instrumentation_detail
+
+namespace instrumentation {
+
+inline void count(Counter c, uint64_t n = 1) {
+  if constexpr (enabled)
+    instrumentation_detail::add(
+        instrumentation_detail::thread_block().counters[static_cast<size_t>(c)], n);
+}
+
+// Adds the time from construction to destruction to `timer`
+class Scoped_Timer {
+public:
+  explicit Scoped_Timer(Timer timer) : timer(timer) {
+    if constexpr (enabled)
+      start = std::chrono::steady_clock::now();
+  }
+  ~Scoped_Timer() {
+    if constexpr (enabled) {
+      const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+      auto &block = instrumentation_detail::thread_block();
+      const size_t t = static_cast<size_t>(timer);
+      instrumentation_detail::add(block.calls[t], 1);
+      instrumentation_detail::add(block.total_ns[t], ns);
+      if (ns > block.max_ns[t].load(std::memory_order_relaxed))
+        block.max_ns[t].store(ns, std::memory_order_relaxed);
+    }
+  }
+  Scoped_Timer(const Scoped_Timer &) = delete;
+  Scoped_Timer &operator=(const Scoped_Timer &) = delete;
+
+private:
+  [[maybe_unused]] Timer timer;
+  std::chrono::steady_clock::time_point start;
+};
+
+} // namespace instrumentation
+
+#endif // INSTRUMENTATION_HPP
@@ -1,7 +1,12 @@
 #include "logger.hpp"
 
-// Define the static filename for FileLogger
-const std::string FileLogger::filename = "logic_log.txt";
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 // Factory methods for Logger
 std::shared_ptr<Logger> Logger::create_silent_logger() {
@@ -12,27 +17,151 @@ std::shared_ptr<Logger> Logger::create_stdout_logger() {
     return std::make_shared<StdoutLogger>();
 }
 
-std::shared_ptr<Logger> Logger::create_file_logger() {
-    return std::make_shared<FileLogger>();
+std::shared_ptr<Logger> Logger::create_file_logger(const std::string& path) {
+    return std::make_shared<FileLogger>(path);
 }
 
 // FileLogger implementation
-FileLogger::FileLogger() {
-    file.open(filename, std::ios::out | std::ios::trunc);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open log file " << filename << std::endl;
+FileLogger::FileLogger(const std::string& path, const File_Logger_Options& options)
+    : overflow(options.overflow), batch_bytes(std::max<size_t>(options.batch_bytes, 1)),
+      mask(std::bit_ceil(std::max<size_t>(options.capacity, 2)) - 1),
+      slots(std::make_unique<Slot[]>(mask + 1)) {
+    for (uint64_t i = 0; i <= mask; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open log file " << path << ": " << std::strerror(errno)
+                  << std::endl;
+        return;
     }
+    writer = std::thread([this]() { run_writer(); });
 }
 
 FileLogger::~FileLogger() {
-    if (file.is_open()) {
-        file.close();
+    if (fd < 0) {
+        return;
     }
+    stopping.store(true, std::memory_order_release);
+    published.fetch_add(1, std::memory_order_release);
+    published.notify_one();
+    writer.join();
+    ::close(fd);
 }
 
 void FileLogger::log(const std::string& message) {
-    if (file.is_open()) {
-        file << message << std::endl;
-        file.flush();
+    log(std::string(message));
+}
+
+void FileLogger::log(std::string&& message) {
+    if (fd < 0) {
+        return;
+    }
+    while (!try_enqueue(message)) {
+        if (overflow != Overflow_Policy::BLOCK) {
+            dropped_messages.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        // Slots are freed before `written` moves, so a retry after reading it
+        // either succeeds or sleeps until the next batch is written.
+        const uint64_t seen = written.load(std::memory_order_acquire);
+        if (try_enqueue(message)) {
+            break;
+        }
+        written.wait(seen, std::memory_order_acquire);
+    }
+    // only wakes the writer if it sleeps
+    published.fetch_add(1, std::memory_order_release);
+    published.notify_one();
+}
+
+bool FileLogger::try_enqueue(std::string& message) {
+    uint64_t position = enqueue_position.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = slots[position & mask];
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        const int64_t difference = int64_t(sequence - position);
+        if (difference == 0) {
+            if (enqueue_position.compare_exchange_weak(position, position + 1,
+                                                       std::memory_order_relaxed)) {
+                slot.message = std::move(message);
+                slot.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (difference < 0) {
+            return false; // the slot still holds the message of the previous lap
+        } else {
+            position = enqueue_position.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void FileLogger::flush() {
+    if (fd < 0) {
+        return;
+    }
+    // every position claimed so far is published shortly and then written
+    const uint64_t target = enqueue_position.load(std::memory_order_acquire);
+    for (uint64_t done = written.load(std::memory_order_acquire); done < target;
+         done = written.load(std::memory_order_acquire)) {
+        written.wait(done, std::memory_order_acquire);
+    }
+}
+
+static void write_all(int fd, const std::string& data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        const ssize_t n = ::write(fd, data.data() + offset, data.size() - offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return; // nothing sensible to do about a failing log file
+        }
+        offset += n;
+    }
+}
+
+// Drains the ring into one buffer per write, then sleeps until a producer
+// publishes a message. Positions are read in order, so `written` also tells
+// flush that every earlier message is in the file.
+void FileLogger::run_writer() {
+    std::string batch;
+    uint64_t position = 0;
+    uint64_t reported = 0;
+    for (;;) {
+        const uint64_t seen = published.load(std::memory_order_acquire);
+        const uint64_t first = position;
+        batch.clear();
+        while (batch.size() < batch_bytes) {
+            Slot& slot = slots[position & mask];
+            if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+                break;
+            }
+            batch += slot.message;
+            batch += '\n';
+            slot.message.clear();
+            slot.sequence.store(position + mask + 1, std::memory_order_release);
+            ++position;
+        }
+        if (overflow == Overflow_Policy::DROP_AND_REPORT) {
+            const uint64_t lost = dropped_messages.load(std::memory_order_relaxed);
+            if (lost != reported) {
+                batch += '[';
+                batch += std::to_string(lost - reported);
+                batch += " log messages dropped]\n";
+                reported = lost;
+            }
+        }
+        write_all(fd, batch);
+        if (position != first) {
+            written.store(position, std::memory_order_release);
+            written.notify_all();
+            continue;
+        }
+        if (stopping.load(std::memory_order_acquire)) {
+            return;
+        }
+        published.wait(seen, std::memory_order_acquire);
     }
 }
@@ -1,29 +1,123 @@
 #ifndef LOGGER_HPP
 #define LOGGER_HPP
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
-#include <fstream>
-#include <string>
+#include <ostream>
+#include <streambuf>
 #include <memory>
+#include <string>
+#include <thread>
+
+enum class Log_Level { TRACE, DEBUG, INFO, WARNING, ERROR, OFF };
+
+// Leveled logging macros below this level are compiled out, arguments
+// included: -DLOGIC_LOG_LEVEL=2 keeps INFO and above.
+#ifndef LOGIC_LOG_LEVEL
+#define LOGIC_LOG_LEVEL 0
+#endif
+
+namespace logging_detail {
+
+// Stream appending to a string whose capacity is kept from line to line
+class Line_Buffer : public std::streambuf {
+public:
+    std::string line;
+
+protected:
+    int_type overflow(int_type c) override {
+        if (c != traits_type::eof()) {
+            line.push_back(traits_type::to_char_type(c));
+        }
+        return c;
+    }
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        line.append(s, n);
+        return n;
+    }
+};
+
+struct Line_Stream {
+    Line_Buffer buffer;
+    std::ostream stream{&buffer};
+    const std::ios_base::fmtflags flags = stream.flags();
+};
+
+// one per thread, reused by every message
+inline Line_Stream& line_stream() {
+    thread_local Line_Stream line;
+    return line;
+}
+
+} // namespace logging_detail
 
 // TODO Exercise 3
 // Abstract Logger class
 class Logger {
 public:
     virtual ~Logger() = default;
-    
+
     // Log a message
     virtual void log(const std::string& message) = 0;
-    
+
+    // Messages below the level are dropped by the LOGIC_* macros before any
+    // argument is evaluated or formatted
+    void set_level(Log_Level level) { threshold = level; }
+    Log_Level level() const { return threshold; }
+    bool enabled(Log_Level level) const { return level >= threshold; }
+
+    // Formats the arguments with operator<< into the line buffer of the
+    // calling thread, then logs it. An argument must not log while it is
+    // being formatted.
+    template <typename... Args>
+    void log_format(const Args&... args) {
+        logging_detail::Line_Stream& line = logging_detail::line_stream();
+        line.buffer.line.clear();
+        line.stream.flags(line.flags);
+        (line.stream << ... << args);
+        log(line.buffer.line);
+    }
+    // Returns once the messages logged before the call have reached their
+    // destination
+    virtual void flush() {}
+
     // Create specific logger types
     static std::shared_ptr<Logger> create_silent_logger();
     static std::shared_ptr<Logger> create_stdout_logger();
-    static std::shared_ptr<Logger> create_file_logger();
+    static std::shared_ptr<Logger> create_file_logger(const std::string& path = "logic_log.txt");
+
+protected:
+    Log_Level threshold = Log_Level::TRACE;
 };
 
+// Leveled logging: LOGIC_DEBUG(logger, "simplify ", formula_text(*f))
+//
+// `logger` is a pointer or shared_ptr, possibly null. The arguments are only
+// evaluated and formatted if the logger is enabled for the level, and not
+// compiled at all below LOGIC_LOG_LEVEL, so disabled logging in hot paths
+// costs a branch or nothing.
+#define LOGIC_LOG(logger, level, ...)                                          \
+    do {                                                                       \
+        if constexpr (static_cast<int>(level) >= LOGIC_LOG_LEVEL) {            \
+            auto&& logic_log_target = (logger);                                \
+            if (logic_log_target && logic_log_target->enabled(level)) {        \
+                logic_log_target->log_format(__VA_ARGS__);                     \
+            }                                                                  \
+        }                                                                      \
+    } while (0)
+
+#define LOGIC_TRACE(logger, ...) LOGIC_LOG(logger, Log_Level::TRACE, __VA_ARGS__)
+#define LOGIC_DEBUG(logger, ...) LOGIC_LOG(logger, Log_Level::DEBUG, __VA_ARGS__)
+#define LOGIC_INFO(logger, ...) LOGIC_LOG(logger, Log_Level::INFO, __VA_ARGS__)
+#define LOGIC_WARNING(logger, ...) LOGIC_LOG(logger, Log_Level::WARNING, __VA_ARGS__)
+#define LOGIC_ERROR(logger, ...) LOGIC_LOG(logger, Log_Level::ERROR, __VA_ARGS__)
+
 // Silent logger - no output
 class SilentLogger : public Logger {
 public:
+    SilentLogger() { threshold = Log_Level::OFF; }
     void log(const std::string& /* message */) override {};
 };
 
@@ -35,16 +129,70 @@ public:
     }
 };
 
-// Logger to file (hardcoded file name)
+// What log does when the ring buffer of a FileLogger is full
+enum class Overflow_Policy {
+    BLOCK,           // wait for the writer thread to make room
+    DROP,            // discard the message, see FileLogger::dropped
+    DROP_AND_REPORT, // discard, and write the number of lost messages to the file
+};
+
+struct File_Logger_Options {
+    // messages in flight, rounded up to a power of two
+    size_t capacity = 1 << 14;
+    Overflow_Policy overflow = Overflow_Policy::BLOCK;
+    // the writer thread hands the file at most this many bytes per write
+    size_t batch_bytes = 1 << 20;
+};
+
+// Asynchronous logger to a file
+//
+// log moves the message into a bounded ring buffer and returns, without a
+// lock or a system call unless the writer thread is asleep. Any number of
+// threads may log at once. A background thread drains the ring and writes the
+// messages, one per line, in large batches. The destructor writes every
+// pending message before closing the file.
 class FileLogger : public Logger {
 public:
-    FileLogger();
+    explicit FileLogger(const std::string& path = "logic_log.txt",
+                        const File_Logger_Options& options = {});
     ~FileLogger() override;
+    FileLogger(const FileLogger&) = delete;
+    FileLogger& operator=(const FileLogger&) = delete;
+
     void log(const std::string& message) override;
-    
+    void log(std::string&& message);
+    void flush() override;
+
+    bool is_open() const { return fd >= 0; }
+    // messages lost to a full ring buffer
+    uint64_t dropped() const { return dropped_messages.load(std::memory_order_relaxed); }
+
 private:
-    std::ofstream file;
-    static const std::string filename;
+    // Bounded multi-producer queue: a slot is free for the position p when
+    // its sequence is p, and holds the message of position p when it is p + 1.
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        std::string message;
+    };
+
+    int fd = -1;
+    const Overflow_Policy overflow;
+    const size_t batch_bytes;
+    const uint64_t mask;
+    std::unique_ptr<Slot[]> slots;
+
+    // next position to claim, shared by the producers
+    alignas(64) std::atomic<uint64_t> enqueue_position{0};
+    // positions published, the writer sleeps on it
+    alignas(64) std::atomic<uint64_t> published{0};
+    // positions handed to the file, flush and blocked producers sleep on it
+    alignas(64) std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> dropped_messages{0};
+    std::atomic<bool> stopping{false};
+    std::thread writer;
+
+    bool try_enqueue(std::string& message);
+    void run_writer();
 };
 
 #endif // LOGGER_HPP
@@ -1,12 +1,30 @@
 #include "logic_builder.hpp"
+#include "dedupe.hpp"
+#include "formula_printer.hpp"
+#include "instrumentation.hpp"
 #include "logger.hpp"
 #include "logic_node.hpp"
+#include "logic_program.hpp"
+#include "simplifier_cache.hpp"
+#include "traversal.hpp"
+#include "wide_evaluation.hpp"
 
 #include <algorithm>
 #include <cassert>
+#include <iterator>
 #include <memory>
 #include <unordered_set>
 
+// formulas in log lines are cut to a short prefix
+static constexpr Print_Options log_print{.max_depth = 8, .max_length = 512};
+
+// Constant test through the kind tag, without dynamic_pointer_cast and its
+// reference count traffic
+static bool is_constant(const std::shared_ptr<Logic_Node> &f, bool value) {
+  const Constant *constant = as_constant(*f);
+  return constant && constant->getValue() == value;
+}
+
 bool Logic_Node_Equal::operator()(
     const std::shared_ptr<Logic_Node> &lhs,
     const std::shared_ptr<Logic_Node> &rhs) const {
@@ -17,41 +35,148 @@ bool Logic_Node_Equal::operator()(
 
 size_t
 Logic_Node_Hash::operator()(const std::shared_ptr<Logic_Node> &lhs) const {
-  if (!lhs) return 0;
-  
-  // Hash based on the type and content of the node
-  if (auto constant = std::dynamic_pointer_cast<Constant>(lhs)) {
-    // Hash for constants: 1 for True, 0 for False
-    return constant->getValue() ? 1 : 0;
-  } 
-  else if (auto variable = std::dynamic_pointer_cast<Variable>(lhs)) {
-    // Hash for variables: use the literal value
-    return std::hash<int>()(variable->getLiteral()) * 31;
-  } 
-  else if (auto gate = std::dynamic_pointer_cast<Gate>(lhs)) {
-    // Hash for gates: combine gate type and children hashes
-    size_t hash_value = (gate->getType() == Gate_Type::AND_GATE) ? 17 : 23;
-    
-    // Combine with children hashes
-    for (const auto& child : gate->getChildren()) {
-      hash_value = hash_value * 31 + (*this)(child);
-    }
-    
-    return hash_value;
+  // The hash is stored in the node, see Logic_Node::hash
+  return lhs ? lhs->hash() : 0;
+}
+
+// Must agree with the hash of the gate the key describes
+size_t Logic_Node_Hash::operator()(const Gate_Key &key) const {
+  return Gate::hash_of(key.type, key.children);
+}
+
+bool Logic_Node_Equal::operator()(
+    const Gate_Key &lhs, const std::shared_ptr<Logic_Node> &rhs) const {
+  const Gate *gate = as_gate(*rhs);
+  if (!gate || gate->getType() != lhs.type) return false;
+  const auto& children = gate->getChildren();
+  if (children.size() != lhs.children.size()) return false;
+  for (size_t i = 0; i < children.size(); ++i) {
+    if (!(*this)(lhs.children[i], children[i])) return false;
   }
-  
-  // Fallback to pointer hash if type is unknown
-  return std::hash<const Logic_Node*>()(lhs.get());
+  return true;
+}
+
+Logic_Builder::Logic_Builder()
+    : simplified_representative(Simplifier_Cache::process_cache()) {}
+
+Logic_Builder::Logic_Builder(bool hash_consing) : Logic_Builder() {
+  this->hash_consing = hash_consing;
+}
+
+void Logic_Builder::set_cache_scope(Cache_Scope new_scope) {
+  if (new_scope == scope) {
+    return;
+  }
+  scope = new_scope;
+  simplified_representative = scope == Cache_Scope::PROCESS
+                                  ? Simplifier_Cache::process_cache()
+                                  : std::make_shared<Simplifier_Cache>();
+}
+
+void Logic_Builder::clear_cache() { simplified_representative->clear(); }
+
+// Records `result` as the simplified representative of `f`. If another thread
+// stored one first, that one is returned so that every thread shares it.
+std::shared_ptr<Formula>
+Logic_Builder::remember(const std::shared_ptr<Formula> &f,
+                        std::shared_ptr<Formula> result) {
+  auto representative = simplified_representative->insert(f, result);
+  // entries of other builders are not interned in this one
+  if (hash_consing && !is_interned(representative)) {
+    return result;
+  }
+  return representative;
+}
+
+size_t Logic_Builder::unique_table_size() const {
+  return unique_gates.size() + unique_variables.size() + (unique_true ? 1 : 0) +
+         (unique_false ? 1 : 0);
+}
+
+bool Logic_Builder::is_interned(const std::shared_ptr<Formula> &f) const {
+  switch (f->getKind()) {
+  case Node_Kind::CONSTANT:
+    return f == unique_true || f == unique_false;
+  case Node_Kind::VARIABLE: {
+    auto it = unique_variables.find(static_cast<const Variable &>(*f).getLiteral());
+    return it != unique_variables.end() && it->second == f;
+  }
+  case Node_Kind::AND_GATE:
+  case Node_Kind::OR_GATE:
+    break;
+  }
+  // Only the pointer matters: scanning its bucket avoids the deep comparison
+  // find would run against an equal gate of another builder.
+  if (unique_gates.empty()) {
+    return false;
+  }
+  const size_t bucket = unique_gates.bucket(f);
+  return std::find(unique_gates.begin(bucket), unique_gates.end(bucket), f) !=
+         unique_gates.end(bucket);
 }
 
-Logic_Builder::simplifier_cache Logic_Builder::simplified_representative;
+// Allocates a gate, or returns the interned one in hash-consing mode. The
+// children are expected to be free of constants already.
+std::shared_ptr<Formula>
+Logic_Builder::make_gate(Gate_Type type,
+                         std::vector<std::shared_ptr<Formula>> children) {
+  if (!hash_consing) {
+    instrumentation::count(Counter::NODES_ALLOCATED);
+    return std::make_shared<Gate>(type, std::move(children));
+  }
+
+  // Interned children are equal iff they are the same pointer, so duplicates
+  // can be removed without deep comparisons.
+  std::vector<std::shared_ptr<Formula>> unique_children = std::move(children);
+  keep_first_occurrences(unique_children,
+                         [](const std::shared_ptr<Formula>& child) { return child.get(); });
+  if (unique_children.size() == 1) {
+    return unique_children[0];
+  }
+
+  auto it = unique_gates.find(Gate_Key{type, unique_children});
+  if (it != unique_gates.end()) {
+    instrumentation::count(Counter::UNIQUE_TABLE_HITS);
+    return *it;
+  }
+  instrumentation::count(Counter::NODES_ALLOCATED);
+  auto gate = std::make_shared<Gate>(type, std::move(unique_children));
+  unique_gates.insert(gate);
+  return gate;
+}
 
 std::shared_ptr<Logic_Node> Logic_Builder::make_variable(int literal) {
-  return std::make_shared<Variable>(literal);
+  if (!hash_consing) {
+    instrumentation::count(Counter::NODES_ALLOCATED);
+    return std::make_shared<Variable>(literal);
+  }
+  auto& variable = unique_variables[literal];
+  if (!variable) {
+    instrumentation::count(Counter::NODES_ALLOCATED);
+    variable = std::make_shared<Variable>(literal);
+  } else {
+    instrumentation::count(Counter::UNIQUE_TABLE_HITS);
+  }
+  return variable;
+}
+
+// make_gate removes duplicates by pointer, which only finds the equal
+// children if they are all interned. Foreign children are simplified into the
+// table first, so that constants they simplify to are handled as well.
+void Logic_Builder::intern_children(std::vector<std::shared_ptr<Formula>> &children) {
+  if (!hash_consing) {
+    return;
+  }
+  for (auto &child : children) {
+    if (!is_interned(child)) {
+      child = simplify(child);
+    }
+  }
 }
 
 std::shared_ptr<Logic_Node> Logic_Builder::make_conjunction(
     std::vector<std::shared_ptr<Logic_Node>> children) {
+  intern_children(children);
   // Handle special cases
   if (children.empty()) {
     return make_true(); // AND[] = True
@@ -59,20 +184,16 @@ std::shared_ptr<Logic_Node> Logic_Builder::make_conjunction(
   
   // Check for False constants - if any child is False, the result is False
   for (const auto& child : children) {
-    if (auto constant = std::dynamic_pointer_cast<Constant>(child)) {
-      if (!constant->getValue()) { // False found
-        return make_false();
-      }
+    if (is_constant(child, false)) { // False found
+      return make_false();
     }
   }
   
   // Filter out True constants as they don't affect the result
   std::vector<std::shared_ptr<Logic_Node>> filtered_children;
   for (const auto& child : children) {
-    if (auto constant = std::dynamic_pointer_cast<Constant>(child)) {
-      if (constant->getValue()) { // True constant
-        continue; // Skip True constants
-      }
+    if (is_constant(child, true)) { // True constant
+      continue; // Skip True constants
     }
     filtered_children.push_back(child);
   }
@@ -88,11 +209,12 @@ std::shared_ptr<Logic_Node> Logic_Builder::make_conjunction(
   }
   
   // Create the conjunction gate with filtered children
-  return std::make_shared<Gate>(Gate_Type::AND_GATE, std::move(filtered_children));
+  return make_gate(Gate_Type::AND_GATE, std::move(filtered_children));
 }
 
 std::shared_ptr<Logic_Node> Logic_Builder::make_disjunction(
     std::vector<std::shared_ptr<Logic_Node>> children) {
+  intern_children(children);
   // Handle special cases
   if (children.empty()) {
     return make_false(); // OR[] = False
@@ -100,20 +222,16 @@ std::shared_ptr<Logic_Node> Logic_Builder::make_disjunction(
   
   // Check for True constants - if any child is True, the result is True
   for (const auto& child : children) {
-    if (auto constant = std::dynamic_pointer_cast<Constant>(child)) {
-      if (constant->getValue()) { // True found
-        return make_true();
-      }
+    if (is_constant(child, true)) { // True found
+      return make_true();
     }
   }
   
   // Filter out False constants as they don't affect the result
   std::vector<std::shared_ptr<Logic_Node>> filtered_children;
   for (const auto& child : children) {
-    if (auto constant = std::dynamic_pointer_cast<Constant>(child)) {
-      if (!constant->getValue()) { // False constant
-        continue; // Skip False constants
-      }
+    if (is_constant(child, false)) { // False constant
+      continue; // Skip False constants
     }
     filtered_children.push_back(child);
   }
@@ -129,35 +247,67 @@ std::shared_ptr<Logic_Node> Logic_Builder::make_disjunction(
   }
   
   // Create the disjunction gate with filtered children
-  return std::make_shared<Gate>(Gate_Type::OR_GATE, std::move(filtered_children));
+  return make_gate(Gate_Type::OR_GATE, std::move(filtered_children));
 }
 
 std::shared_ptr<Logic_Node> Logic_Builder::make_true() {
-  return std::make_shared<Constant>(true);
+  if (!hash_consing) {
+    instrumentation::count(Counter::NODES_ALLOCATED);
+    return std::make_shared<Constant>(true);
+  }
+  if (!unique_true) {
+    instrumentation::count(Counter::NODES_ALLOCATED);
+    unique_true = std::make_shared<Constant>(true);
+  } else {
+    instrumentation::count(Counter::UNIQUE_TABLE_HITS);
+  }
+  return unique_true;
 }
 
 std::shared_ptr<Logic_Node> Logic_Builder::make_false() {
-  return std::make_shared<Constant>(false);
+  if (!hash_consing) {
+    instrumentation::count(Counter::NODES_ALLOCATED);
+    return std::make_shared<Constant>(false);
+  }
+  if (!unique_false) {
+    instrumentation::count(Counter::NODES_ALLOCATED);
+    unique_false = std::make_shared<Constant>(false);
+  } else {
+    instrumentation::count(Counter::UNIQUE_TABLE_HITS);
+  }
+  return unique_false;
 }
 
+// Normalizes the children of every gate before the gate itself
+struct Logic_Builder::Normalize_Visitor {
+  Logic_Builder &builder;
+
+  bool enter(const Logic_Node &n) { return n.isGate(); }
+  bool child_done(const Logic_Node &, size_t) { return true; }
+  void leave(const Logic_Node &n);
+};
+
 void Logic_Builder::normalize(std::shared_ptr<Formula> f) {
   // Skip normalization for constants and variables
-  if (std::dynamic_pointer_cast<Constant>(f) || std::dynamic_pointer_cast<Variable>(f)) {
-    return;
-  }
-  
-  // Cast to Gate to access children
-  auto gate = std::dynamic_pointer_cast<Gate>(f);
-  if (!gate) {
+  if (!f->isGate()) {
     return; // Not a gate, nothing to normalize
   }
-  
-  // First, normalize all children recursively
-  auto& children = gate->getChildrenMutable();
-  for (auto& child : children) {
-    normalize(child);
-  }
-  
+  instrumentation::Scoped_Timer timer(Timer::NORMALIZE);
+  LOGIC_DEBUG(logger, "normalize ", formula_text(*f, log_print));
+  // First, normalize all children, then the gate itself
+  Normalize_Visitor visitor{*this};
+  walk_formula(*f, visitor);
+  LOGIC_DEBUG(logger, "normalized ", formula_text(*f, log_print));
+}
+
+// The walk hands out const nodes, normalization changes them in place
+void Logic_Builder::Normalize_Visitor::leave(const Logic_Node &n) {
+  builder.normalize_gate(const_cast<Gate &>(static_cast<const Gate &>(n)));
+}
+
+void Logic_Builder::normalize_gate(Gate &gate) {
+  auto& children = gate.getChildrenMutable();
+
   // Remove duplicates
   std::unordered_set<std::shared_ptr<Logic_Node>, Logic_Node_Hash, Logic_Node_Equal> unique_children;
   std::vector<std::shared_ptr<Logic_Node>> filtered_children;
@@ -169,71 +319,81 @@ void Logic_Builder::normalize(std::shared_ptr<Formula> f) {
   }
   
   // Update children with filtered list (no duplicates)
+  instrumentation::count(Counter::NORMALIZE_DUPLICATES_REMOVED,
+                         children.size() - filtered_children.size());
   children = std::move(filtered_children);
   
   // Handle constants based on gate type
-  if (gate->getType() == Gate_Type::AND_GATE) {
+  if (gate.getType() == Gate_Type::AND_GATE) {
     // For AND gate: if any child is False, replace with False
     // Remove True constants as they don't affect the result
     filtered_children.clear();
     bool has_false = false;
     
     for (const auto& child : children) {
-      if (auto constant = std::dynamic_pointer_cast<Constant>(child)) {
-        if (!constant->getValue()) { // False constant
-          has_false = true;
-          break;
-        }
-        // Skip True constants
-        continue;
+      if (is_constant(child, false)) { // False constant
+        has_false = true;
+        break;
+      }
+      if (is_constant(child, true)) {
+        continue; // Skip True constants
       }
       filtered_children.push_back(child);
     }
     
     if (has_false) {
       // Replace all children with a single False
+      instrumentation::count(Counter::NORMALIZE_CONSTANTS_REMOVED, children.size() - 1);
       children.clear();
       children.push_back(make_false());
     } else {
       // Update children without True constants
+      instrumentation::count(Counter::NORMALIZE_CONSTANTS_REMOVED,
+                             children.size() - filtered_children.size());
       children = std::move(filtered_children);
     }
-  } else if (gate->getType() == Gate_Type::OR_GATE) {
+  } else if (gate.getType() == Gate_Type::OR_GATE) {
     // For OR gate: if any child is True, replace with True
     // Remove False constants as they don't affect the result
     filtered_children.clear();
     bool has_true = false;
     
     for (const auto& child : children) {
-      if (auto constant = std::dynamic_pointer_cast<Constant>(child)) {
-        if (constant->getValue()) { // True constant
-          has_true = true;
-          break;
-        }
-        // Skip False constants
-        continue;
+      if (is_constant(child, true)) { // True constant
+        has_true = true;
+        break;
+      }
+      if (is_constant(child, false)) {
+        continue; // Skip False constants
       }
       filtered_children.push_back(child);
     }
     
     if (has_true) {
       // Replace all children with a single True
+      instrumentation::count(Counter::NORMALIZE_CONSTANTS_REMOVED, children.size() - 1);
       children.clear();
       children.push_back(make_true());
     } else {
       // Update children without False constants
+      instrumentation::count(Counter::NORMALIZE_CONSTANTS_REMOVED,
+                             children.size() - filtered_children.size());
       children = std::move(filtered_children);
     }
   }
   
   // Handle special cases
   if (children.empty()) {
-    if (gate->getType() == Gate_Type::AND_GATE) {
+    if (gate.getType() == Gate_Type::AND_GATE) {
       children.push_back(make_true()); // AND[] = True
     } else { // OR_GATE
       children.push_back(make_false()); // OR[] = False
     }
   }
+
+  // The stored hash is that of the normalized gate, so it is still valid,
+  // and so are the hashes of the ancestors outside of this walk
+  assert(gate.hash() == Gate::hash_of(gate.getType(), children));
 }
 
 std::vector<std::shared_ptr<Formula>> Logic_Builder::collect_children(std::shared_ptr<Formula> f) {
@@ -244,53 +404,92 @@ std::vector<std::shared_ptr<Formula>> Logic_Builder::collect_children(std::share
     return result;
   }
   
-  // Add the current node
-  result.push_back(f);
-  
-  // If it's a gate, recursively collect children
-  auto gate = std::dynamic_pointer_cast<Gate>(f);
-  if (gate) {
-    for (const auto& child : gate->getChildren()) {
-      // Don't include the child itself again (it will be included in its own recursive call)
-      auto child_nodes = collect_children(child);
-      result.insert(result.end(), child_nodes.begin(), child_nodes.end());
-    }
-  }
-  
+  // Every distinct node once, in pre-order
+  for_each_node(f, Visit_Order::PRE_ORDER,
+                [&result](const std::shared_ptr<Formula> &n) { result.push_back(n); });
   return result;
 }
 
-std::shared_ptr<Formula> Logic_Builder::simplify(std::shared_ptr<Formula> f) {
-  // Check if we've already simplified this formula
-  auto it = simplified_representative.find(f);
-  if (it != simplified_representative.end()) {
-    return it->second; // Return cached result
+size_t Logic_Builder::dag_size(const Formula &f) const {
+  size_t size = 0;
+  for_each_node(f, Visit_Order::PRE_ORDER, [&size](const Formula &) { ++size; });
+  return size;
+}
+
+// Simplifies bottom-up: a gate is rebuilt once all its children are
+// simplified. The simplified children are passed on `results`.
+struct Logic_Builder::Simplify_Visitor {
+  Logic_Builder &builder;
+  std::vector<std::shared_ptr<Formula>> results;
+
+  bool enter(const std::shared_ptr<Formula> &f) {
+    if (auto known = builder.simplified_known(f)) {
+      results.push_back(std::move(known));
+      return false;
+    }
+    if (!f->isGate()) {
+      results.push_back(builder.simplify_leaf(f));
+      return false;
+    }
+    return true;
   }
-  
-  // Handle base cases: constants and variables don't need simplification
-  if (std::dynamic_pointer_cast<Constant>(f) || std::dynamic_pointer_cast<Variable>(f)) {
-    // Store in cache and return
-    simplified_representative[f] = f;
-    return f;
+  bool child_done(const std::shared_ptr<Formula> &, size_t) { return true; }
+  void leave(const std::shared_ptr<Formula> &f) {
+    const size_t n = static_cast<const Gate &>(*f).getChildren().size();
+    std::vector<std::shared_ptr<Logic_Node>> simplified_children(
+        std::make_move_iterator(results.end() - n), std::make_move_iterator(results.end()));
+    results.resize(results.size() - n);
+    results.push_back(builder.simplify_gate(f, std::move(simplified_children)));
   }
-  
-  // Cast to Gate to access children
-  auto gate = std::dynamic_pointer_cast<Gate>(f);
-  if (!gate) {
-    // Not a gate, just return as is
+};
+
+std::shared_ptr<Formula> Logic_Builder::simplify(std::shared_ptr<Formula> f) {
+  instrumentation::Scoped_Timer timer(Timer::SIMPLIFY);
+  LOGIC_DEBUG(logger, "simplify ", formula_text(*f, log_print));
+  Simplify_Visitor visitor{*this, {}};
+  walk_formula(f, visitor);
+  LOGIC_DEBUG(logger, "simplified ", formula_text(*visitor.results.back(), log_print));
+  return visitor.results.back();
+}
+
+std::shared_ptr<Formula>
+Logic_Builder::simplified_known(const std::shared_ptr<Formula> &f) {
+  // Interned formulas are simplified by construction
+  if (hash_consing && is_interned(f)) {
     return f;
   }
-  
-  // Get gate type and children
-  Gate_Type type = gate->getType();
-  std::vector<std::shared_ptr<Logic_Node>> children = gate->getChildren();
-  
-  // Recursively simplify all children first
-  std::vector<std::shared_ptr<Logic_Node>> simplified_children;
-  for (const auto& child : children) {
-    simplified_children.push_back(simplify(child));
+
+  // Check if we've already simplified this formula
+  instrumentation::count(Counter::SIMPLIFY_CACHE_LOOKUPS);
+  auto cached = simplified_representative->find(f);
+  if (cached && (!hash_consing || is_interned(cached))) {
+    instrumentation::count(Counter::SIMPLIFY_CACHE_HITS);
+    return cached; // Return cached result
   }
-  
+  return nullptr;
+}
+
+// Constants and variables don't need simplification
+std::shared_ptr<Formula>
+Logic_Builder::simplify_leaf(const std::shared_ptr<Formula> &f) {
+  // In hash-consing mode the representative is the interned leaf
+  std::shared_ptr<Formula> leaf = f;
+  if (hash_consing) {
+    if (const Constant *constant = as_constant(*f))
+      leaf = constant->getValue() ? make_true() : make_false();
+    else
+      leaf = make_variable(static_cast<const Variable &>(*f).getLiteral());
+  }
+  // Store in cache and return
+  return remember(f, leaf);
+}
+
+std::shared_ptr<Formula>
+Logic_Builder::simplify_gate(const std::shared_ptr<Formula> &f,
+                             std::vector<std::shared_ptr<Logic_Node>> simplified_children) {
+  // The children are simplified already, see Simplify_Visitor
+  Gate_Type type = static_cast<const Gate &>(*f).getType();
+
   // Create a new gate with simplified children
   std::shared_ptr<Formula> result;
   
@@ -299,35 +498,28 @@ std::shared_ptr<Formula> Logic_Builder::simplify(std::shared_ptr<Formula> f) {
     // AND[] = True
     if (simplified_children.empty()) {
       result = make_true();
-      simplified_representative[f] = result;
-      return result;
+      return remember(f, result);
     }
     
     // AND[x] = x
     if (simplified_children.size() == 1) {
       result = simplified_children[0];
-      simplified_representative[f] = result;
-      return result;
+      return remember(f, result);
     }
     
     // NEW RULE: AND[... False ...] = False
     for (const auto& child : simplified_children) {
-      if (auto constant = std::dynamic_pointer_cast<Constant>(child)) {
-        if (!constant->getValue()) { // Found False
-          result = make_false();
-          simplified_representative[f] = result;
-          return result;
-        }
+      if (is_constant(child, false)) { // Found False
+        result = make_false();
+        return remember(f, result);
       }
     }
     
     // Filter out True constants as they don't affect the result
     std::vector<std::shared_ptr<Logic_Node>> filtered_children;
     for (const auto& child : simplified_children) {
-      if (auto constant = std::dynamic_pointer_cast<Constant>(child)) {
-        if (constant->getValue()) { // True constant
-          continue; // Skip True constants
-        }
+      if (is_constant(child, true)) { // True constant
+        continue; // Skip True constants
       }
       filtered_children.push_back(child);
     }
@@ -335,15 +527,13 @@ std::shared_ptr<Formula> Logic_Builder::simplify(std::shared_ptr<Formula> f) {
     // If all children were filtered out (all were True), return True
     if (filtered_children.empty()) {
       result = make_true();
-      simplified_representative[f] = result;
-      return result;
+      return remember(f, result);
     }
     
     // If only one child remains after filtering, return it
     if (filtered_children.size() == 1) {
       result = filtered_children[0];
-      simplified_representative[f] = result;
-      return result;
+      return remember(f, result);
     }
     
     // Remove duplicates to ensure perfect structural sharing
@@ -356,41 +546,34 @@ std::shared_ptr<Formula> Logic_Builder::simplify(std::shared_ptr<Formula> f) {
       }
     }
     
-    result = std::make_shared<Gate>(Gate_Type::AND_GATE, std::move(unique_filtered_children));
+    result = make_gate(Gate_Type::AND_GATE, std::move(unique_filtered_children));
   } 
   else { // OR_GATE
     // OR[] = False
     if (simplified_children.empty()) {
       result = make_false();
-      simplified_representative[f] = result;
-      return result;
+      return remember(f, result);
     }
     
     // OR[x] = x
     if (simplified_children.size() == 1) {
       result = simplified_children[0];
-      simplified_representative[f] = result;
-      return result;
+      return remember(f, result);
     }
     
     // NEW RULE: OR[... True ...] = True
     for (const auto& child : simplified_children) {
-      if (auto constant = std::dynamic_pointer_cast<Constant>(child)) {
-        if (constant->getValue()) { // Found True
-          result = make_true();
-          simplified_representative[f] = result;
-          return result;
-        }
+      if (is_constant(child, true)) { // Found True
+        result = make_true();
+        return remember(f, result);
       }
     }
     
     // Filter out False constants as they don't affect the result
     std::vector<std::shared_ptr<Logic_Node>> filtered_children;
     for (const auto& child : simplified_children) {
-      if (auto constant = std::dynamic_pointer_cast<Constant>(child)) {
-        if (!constant->getValue()) { // False constant
-          continue; // Skip False constants
-        }
+      if (is_constant(child, false)) { // False constant
+        continue; // Skip False constants
       }
       filtered_children.push_back(child);
     }
@@ -398,15 +581,13 @@ std::shared_ptr<Formula> Logic_Builder::simplify(std::shared_ptr<Formula> f) {
     // If all children were filtered out (all were False), return False
     if (filtered_children.empty()) {
       result = make_false();
-      simplified_representative[f] = result;
-      return result;
+      return remember(f, result);
     }
     
     // If only one child remains after filtering, return it
     if (filtered_children.size() == 1) {
       result = filtered_children[0];
-      simplified_representative[f] = result;
-      return result;
+      return remember(f, result);
     }
     
     // Remove duplicates to ensure perfect structural sharing
@@ -419,16 +600,104 @@ std::shared_ptr<Formula> Logic_Builder::simplify(std::shared_ptr<Formula> f) {
       }
     }
     
-    result = std::make_shared<Gate>(Gate_Type::OR_GATE, std::move(unique_filtered_children));
+    result = make_gate(Gate_Type::OR_GATE, std::move(unique_filtered_children));
   }
   
   // Store the result in the cache
-  simplified_representative[f] = result;
-  
-  return result;
+  return remember(f, result);
 }
 
 bool Logic_Builder::evaluate(std::shared_ptr<Formula> f,
                              const std::vector<bool> &model) const {
+  instrumentation::Scoped_Timer timer(Timer::EVALUATE);
+  if (memoized_evaluation) {
+    return evaluate_memoized(*f, model);
+  }
   return f->evaluation(model);
 }
+
+// Evaluates every node at most once per call: evaluated nodes are not
+// entered, and gates are recorded when they are left
+struct Logic_Builder::Memoized_Visitor {
+  const Logic_Builder &builder;
+  const std::vector<bool> &model;
+  std::vector<bool> values;
+
+  bool enter(const Logic_Node &n) {
+    if (const bool *value = builder.memo.find(n)) {
+      values.push_back(*value);
+      return false;
+    }
+    if (!n.isGate()) {
+      values.push_back(n.evaluation(model));
+      builder.memo.insert(n, values.back());
+      return false;
+    }
+    values.push_back(n.getKind() == Node_Kind::AND_GATE);
+    return true;
+  }
+  bool child_done(const Logic_Node &parent, size_t) {
+    const bool child = values.back();
+    values.pop_back();
+    // a controlling value decides the gate
+    if (child != (parent.getKind() == Node_Kind::AND_GATE)) {
+      values.back() = child;
+      return false;
+    }
+    return true;
+  }
+  void leave(const Logic_Node &n) { builder.memo.insert(n, values.back()); }
+};
+
+bool Logic_Builder::evaluate_memoized(const Formula &f,
+                                      const std::vector<bool> &model) const {
+  memo.clear(f.getId());
+  Memoized_Visitor visitor{*this, model, {}};
+  walk_formula(f, visitor);
+  return visitor.values.back();
+}
+
+uint64_t Logic_Builder::evaluate_batch(std::shared_ptr<Formula> f,
+                                       const std::vector<uint64_t> &models) const {
+  return f->evaluation_batch(models);
+}
+
+std::vector<uint64_t>
+Logic_Builder::evaluate_wide(std::shared_ptr<Formula> f,
+                             const std::vector<uint64_t> &models,
+                             size_t words) const {
+  return ::evaluate_wide(*f, models, words);
+}
+
+Logic_Program Logic_Builder::compile(std::shared_ptr<Formula> f) const {
+  return Logic_Program::compile(*f);
+}
+
+std::vector<uint64_t>
+Logic_Builder::pack_models(const std::vector<std::vector<bool>> &models) {
+  assert(models.size() <= 64);
+  size_t variables = 0;
+  for (const auto& model : models) {
+    variables = std::max(variables, model.size());
+  }
+  std::vector<uint64_t> packed(variables, 0);
+  for (size_t j = 0; j < models.size(); ++j) {
+    for (size_t i = 0; i < models[j].size(); ++i) {
+      if (models[j][i]) {
+        packed[i] |= uint64_t(1) << j;
+      }
+    }
+  }
+  return packed;
+}
+
+std::vector<bool> Logic_Builder::unpack_model(const std::vector<uint64_t> &models,
+                                              size_t index, size_t words) {
+  assert(index < 64 * words);
+  assert(models.size() % words == 0);
+  std::vector<bool> model(models.size() / words);
+  for (size_t i = 0; i < model.size(); ++i) {
+    model[i] = (models[i * words + index / 64] >> (index % 64)) & 1;
+  }
+  return model;
+}
@@ -1,30 +1,78 @@
 #ifndef LOGIC_HPP
 #define LOGIC_HPP
 
+#include <cstdint>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "node_arena.hpp"
+#include "traversal.hpp"
+
 class Logic_Node;
 class Gate;
 class Variable;
 class Constant;
 class Logger;
+class Logic_Program;
+class Simplifier_Cache;
 
 typedef Logic_Node Formula;
 
+enum class Gate_Type;
+
+// Lookup key for a gate that has not been allocated yet. Used to probe the
+// unique table without constructing a node first.
+struct Gate_Key {
+  Gate_Type type;
+  const std::vector<std::shared_ptr<Logic_Node>> &children;
+};
+
 struct Logic_Node_Equal {
+  using is_transparent = void;
   bool operator()(const std::shared_ptr<Logic_Node> &lhs,
                   const std::shared_ptr<Logic_Node> &rhs) const;
+  bool operator()(const Gate_Key &lhs,
+                  const std::shared_ptr<Logic_Node> &rhs) const;
+  bool operator()(const std::shared_ptr<Logic_Node> &lhs,
+                  const Gate_Key &rhs) const {
+    return (*this)(rhs, lhs);
+  }
 };
 struct Logic_Node_Hash {
+  using is_transparent = void;
   size_t operator()(const std::shared_ptr<Logic_Node> &rhs) const;
+  size_t operator()(const Gate_Key &key) const;
 };
 
+// Scope of the simplifier cache: shared by every builder of the process, or
+// private to one builder
+enum class Cache_Scope { PROCESS, BUILDER };
+
 // Function declarations
+//
+// Different builders can be used from different threads, including simplify
+// through a shared process-wide cache. A single builder is not thread-safe.
 class Logic_Builder {
 private:
 public:
+  Logic_Builder();
+  // With hash-consing enabled, every make_* call first looks up a unique table
+  // so that structurally equal formulas are the same object. Gates built this
+  // way never contain constants or duplicated children, hence they are already
+  // normalized and simplified.
+  explicit Logic_Builder(bool hash_consing);
+
+  void set_hash_consing(bool enable) { hash_consing = enable; }
+  bool uses_hash_consing() const { return hash_consing; }
+
+  // With memoized evaluation, `evaluate` computes every node of the DAG at most
+  // once per model, so shared subformulas do not make evaluation exponential.
+  void set_memoized_evaluation(bool enable) { memoized_evaluation = enable; }
+  bool uses_memoized_evaluation() const { return memoized_evaluation; }
+  size_t unique_table_size() const;
+
   std::shared_ptr<Formula> make_variable(int literal);
   std::shared_ptr<Formula>
   make_conjunction(std::vector<std::shared_ptr<Formula>> children);
@@ -37,13 +85,94 @@ public:
 
   void normalize (std::shared_ptr<Formula>f);
   bool evaluate (std::shared_ptr<Formula> f, const std::vector<bool> &model) const;
+  // Evaluation with per-node memoization, independently of the mode. The
+  // scratch state lives in the builder, hence concurrent calls on the same
+  // builder are not allowed.
+  bool evaluate_memoized(const Formula &f, const std::vector<bool> &model) const;
+  // Evaluates 64 models at once, see Logic_Node::evaluation_batch for the
+  // layout of `models`.
+  uint64_t evaluate_batch(std::shared_ptr<Formula> f,
+                          const std::vector<uint64_t> &models) const;
+  // Evaluates 64 * `words` models with the widest SIMD kernel available, see
+  // wide_evaluation.hpp for the layout of `models`.
+  std::vector<uint64_t> evaluate_wide(std::shared_ptr<Formula> f,
+                                      const std::vector<uint64_t> &models,
+                                      size_t words) const;
+  // Compiles the formula into a flat instruction tape, see logic_program.hpp
+  Logic_Program compile(std::shared_ptr<Formula> f) const;
+  // Conversions between up to 64 models and the transposed batch layout
+  static std::vector<uint64_t>
+  pack_models(const std::vector<std::vector<bool>> &models);
+  // Extracts model `index` from a batch spanning `words` words per variable
+  static std::vector<bool> unpack_model(const std::vector<uint64_t> &models,
+                                        size_t index, size_t words = 1);
+  // Distinct nodes of `f` in pre-order, shared subformulas once. Prefer
+  // for_each_node (traversal.hpp) to stream the nodes, or dag_size to count
+  // them, without building the vector.
   std::vector<std::shared_ptr<Formula>> collect_children(std::shared_ptr<Formula> f);
-  using simplifier_cache = std::unordered_map<std::shared_ptr<Formula>, std::shared_ptr<Formula>, Logic_Node_Hash, Logic_Node_Equal>; // Exercise 5: Cache for simplified formulas
+  size_t dag_size(const Formula &f) const;
+  using simplifier_cache = Simplifier_Cache; // Exercise 5: Cache for simplified formulas
 
-  void clear_cache() { simplified_representative.clear(); } // for the fuzzer
+  // The process scope is the default. Switching scope does not move entries.
+  void set_cache_scope(Cache_Scope scope);
+  Cache_Scope cache_scope() const { return scope; }
+  void clear_cache(); // for the fuzzer
+  // memory budget, eviction policy and statistics, see simplifier_cache.hpp
+  simplifier_cache &cache() const { return *simplified_representative; }
+
+  // Index-based backend: formulas stored as NodeIds in a struct-of-arrays
+  // arena owned by the builder. Node_Arena::import and export_formula convert
+  // from and to shared_ptr formulas, Arena_Formula wraps an id in the Formula
+  // interface.
+  Node_Arena &arena() { return node_arena; }
+  const Node_Arena &arena() const { return node_arena; }
+
+  // Receives DEBUG traces of simplify and normalize, see the LOGIC_* macros
+  // of logger.hpp. None by default.
+  void set_logger(std::shared_ptr<Logger> logger) { this->logger = std::move(logger); }
+  const std::shared_ptr<Logger> &get_logger() const { return logger; }
 
 protected:
-  static simplifier_cache simplified_representative;
+  std::shared_ptr<simplifier_cache> simplified_representative;
+  Cache_Scope scope = Cache_Scope::PROCESS;
+
+private:
+  std::shared_ptr<Formula> make_gate(Gate_Type type,
+                                     std::vector<std::shared_ptr<Formula>> children);
+  bool is_interned(const std::shared_ptr<Formula> &f) const;
+  // replaces the children built elsewhere by their interned representatives
+  void intern_children(std::vector<std::shared_ptr<Formula>> &children);
+  std::shared_ptr<Formula> remember(const std::shared_ptr<Formula> &f,
+                                    std::shared_ptr<Formula> result);
+
+  // Steps of simplify, which walks the formula with an explicit stack (see
+  // traversal.hpp). `simplified_known` returns nullptr if `f` must be visited.
+  struct Simplify_Visitor;
+  std::shared_ptr<Formula> simplified_known(const std::shared_ptr<Formula> &f);
+  std::shared_ptr<Formula> simplify_leaf(const std::shared_ptr<Formula> &f);
+  std::shared_ptr<Formula>
+  simplify_gate(const std::shared_ptr<Formula> &f,
+                std::vector<std::shared_ptr<Logic_Node>> simplified_children);
+  struct Normalize_Visitor;
+  void normalize_gate(Gate &gate);
+
+  // Hash-consing state. Interned gates are kept in `unique_gates`, variables
+  // and constants have their own tables since they are keyed by a value.
+  bool hash_consing = false;
+  std::unordered_set<std::shared_ptr<Formula>, Logic_Node_Hash, Logic_Node_Equal>
+      unique_gates;
+  std::unordered_map<int, std::shared_ptr<Formula>> unique_variables;
+  std::shared_ptr<Formula> unique_true;
+  std::shared_ptr<Formula> unique_false;
+
+  // Memoized evaluation state: the value of the nodes evaluated for the
+  // current model, sized by the formula evaluated
+  bool memoized_evaluation = false;
+  mutable Node_Id_Table<bool> memo;
+  struct Memoized_Visitor;
+
+  Node_Arena node_arena;
+  std::shared_ptr<Logger> logger;
 };
 
 #endif // LOGIC_HPP
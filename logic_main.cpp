@@ -1,9 +1,31 @@
+#include "bdd.hpp"
+#include "dag_file.hpp"
+#include "dimacs.hpp"
+#include "formula_parser.hpp"
+#include "formula_printer.hpp"
+#include "fuzzer.hpp"
+#include "instrumentation.hpp"
+#include "logger.hpp"
 #include "logic_builder.hpp"
 #include "logic_node.hpp"
+#include "logic_program.hpp"
+#include "random.hpp"
+#include "simplifier_cache.hpp"
+#include "sat_solver.hpp"
+#include "traversal.hpp"
+#include "tseitin.hpp"
+#include "wide_evaluation.hpp"
+#include "workload_generator.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
 #include <memory>
+#include <sstream>
 #include <vector>
 #include <cassert>
 #include <iostream>
+#include <thread>
+#include <unordered_map>
 
 int main() {
   Logic_Builder builder;
@@ -110,6 +132,747 @@ int main() {
   assert(constant != nullptr);
   assert(constant->getValue() == false);
   
+  // Test 8: Hash-consing makes equal formulas pointer-identical
+  std::cout << "\nTest 8: Hash-consing" << std::endl;
+  Logic_Builder consing(true);
+  auto c1 = consing.make_conjunction({consing.make_variable(1), consing.make_variable(2),
+                                      consing.make_true()});
+  auto c2 = consing.make_conjunction({consing.make_variable(1), consing.make_variable(2)});
+  auto c3 = consing.make_disjunction({c1, consing.make_variable(3), c2});
+  std::cout << "Hash-consed formula: " << *c3 << std::endl;
+  assert(c1 == c2);
+  assert(c3->arity() == 2); // the duplicated conjunction is removed
+  assert(consing.make_false() == consing.make_false());
+  assert(consing.simplify(c3) == c3);
+  assert(consing.simplify(g1) == c1); // foreign formulas map into the table
+  assert(consing.unique_table_size() == 7);
+  // wide gates are deduplicated by sorting, first occurrences in order
+  std::vector<std::shared_ptr<Logic_Node>> wide8;
+  for (int i = 0; i < 100; ++i)
+    wide8.push_back(consing.make_variable(i % 40 + 1));
+  auto w8 = consing.make_disjunction(wide8);
+  assert(w8->arity() == 40);
+  for (int i = 0; i < 40; ++i)
+    assert(static_cast<const Gate &>(*w8).getChildren()[i] == consing.make_variable(i + 1));
+  wide8.resize(40);
+  assert(consing.make_disjunction(wide8) == w8);
+  // children of another builder are interned before duplicates are removed
+  Logic_Builder plain8;
+  auto foreign8 = consing.make_conjunction({plain8.make_variable(1), plain8.make_variable(1)});
+  assert(foreign8 == consing.make_variable(1));
+  auto mixed8 = consing.make_conjunction(
+      {plain8.make_disjunction({plain8.make_variable(2), plain8.make_variable(3)}),
+       consing.make_disjunction({consing.make_variable(2), consing.make_variable(3)}),
+       consing.make_variable(4)});
+  assert(mixed8->arity() == 2 && consing.simplify(mixed8) == mixed8);
+
+  // Test 9: Batch evaluation agrees with single-model evaluation
+  std::cout << "\nTest 9: Batch evaluation" << std::endl;
+  auto f9 = builder.make_disjunction(
+      {builder.make_conjunction({builder.make_variable(1), builder.make_variable(-2)}),
+       builder.make_conjunction({builder.make_variable(3), builder.make_variable(2)}),
+       builder.make_variable(-4)});
+  std::vector<std::vector<bool>> models9;
+  for (unsigned m = 0; m < 16; ++m) {
+    models9.push_back({bool(m & 1), bool(m & 2), bool(m & 4), bool(m & 8)});
+  }
+  const uint64_t batch9 = builder.evaluate_batch(f9, Logic_Builder::pack_models(models9));
+  for (unsigned m = 0; m < 16; ++m) {
+    assert(((batch9 >> m) & 1) == builder.evaluate(f9, models9[m]));
+    assert(Logic_Builder::unpack_model(Logic_Builder::pack_models(models9), m) == models9[m]);
+  }
+
+  // Test 10: Every wide kernel agrees with batch evaluation
+  std::cout << "\nTest 10: Wide evaluation" << std::endl;
+  const size_t words10 = 19; // not a multiple of any vector width
+  std::vector<uint64_t> models10;
+  for (size_t i = 0; i < 4 * words10; ++i) {
+    models10.push_back(0x9e3779b97f4a7c15ull * (i + 1));
+  }
+  const Wide_Kernel detected = detect_wide_kernel();
+  for (Wide_Kernel kernel : {Wide_Kernel::SCALAR, Wide_Kernel::AVX2, Wide_Kernel::AVX512}) {
+    if (!wide_kernel_supported(kernel)) continue;
+    set_wide_kernel(kernel);
+    std::cout << "Kernel " << wide_kernel_name(kernel) << std::endl;
+    const std::vector<uint64_t> wide10 = builder.evaluate_wide(f9, models10, words10);
+    for (size_t w = 0; w < words10; ++w) {
+      std::vector<uint64_t> batch_models;
+      for (size_t i = 0; i < 4; ++i) batch_models.push_back(models10[i * words10 + w]);
+      assert(wide10[w] == builder.evaluate_batch(f9, batch_models));
+    }
+  }
+  set_wide_kernel(detected);
+
+  // Test 11: Compiled programs agree with the formula, with shared nodes once
+  std::cout << "\nTest 11: Compiled evaluation" << std::endl;
+  auto shared11 = builder.make_disjunction({builder.make_variable(2), builder.make_variable(-3)});
+  auto f11 = builder.make_conjunction(
+      {builder.make_disjunction({builder.make_variable(-1),
+                                 builder.make_conjunction({shared11, builder.make_variable(4)})}),
+       builder.make_disjunction({shared11, builder.make_variable(1), builder.make_false()}),
+       f9});
+  const Logic_Program program11 = builder.compile(f11);
+  std::cout << "Program size: " << program11.size() << std::endl;
+  assert(program11.size() == 18);
+  std::vector<std::vector<bool>> models11;
+  for (unsigned m = 0; m < 16; ++m) {
+    models11.push_back({bool(m & 1), bool(m & 2), bool(m & 4), bool(m & 8)});
+    assert(program11.evaluate(models11.back()) == builder.evaluate(f11, models11.back()));
+  }
+  const std::vector<uint64_t> packed11 = Logic_Builder::pack_models(models11);
+  assert(program11.evaluate_batch(packed11) == builder.evaluate_batch(f11, packed11));
+
+  // Test 12: Memoized evaluation is linear in the DAG size
+  std::cout << "\nTest 12: Memoized evaluation" << std::endl;
+  std::shared_ptr<Logic_Node> chain12 = builder.make_variable(1);
+  for (int level = 0; level < 64; ++level) {
+    // both children share `chain12`, so the unfolded tree doubles per level
+    chain12 = builder.make_conjunction(
+        {builder.make_disjunction({chain12, builder.make_variable(2)}),
+         builder.make_disjunction({chain12, builder.make_variable(3)})});
+  }
+  Logic_Builder memo_builder;
+  memo_builder.set_memoized_evaluation(true);
+  assert(memo_builder.evaluate(chain12, {true, false, false}));
+  assert(!memo_builder.evaluate(chain12, {false, false, false}));
+  assert(memo_builder.evaluate(chain12, {false, true, true}));
+  assert(memo_builder.evaluate_memoized(*f11, models11[5]) == builder.evaluate(f11, models11[5]));
+  // nodes far older than the root, and children newer than it, are memoized
+  // outside of the slots indexed by id
+  std::shared_ptr<Logic_Node> old12 = builder.make_variable(2);
+  for (int i = 0; i < 100000; ++i) {
+    builder.make_variable(3);
+  }
+  std::shared_ptr<Logic_Node> gate12 =
+      builder.make_disjunction({old12, builder.make_variable(3), old12});
+  as_gate(*gate12)->getChildrenMutable()[1] =
+      builder.make_conjunction({chain12, builder.make_variable(1)});
+  as_gate(*gate12)->update_hash();
+  assert(memo_builder.evaluate_memoized(*gate12, {true, false, false}));
+  assert(memo_builder.evaluate_memoized(*gate12, {false, true, false}));
+  assert(!memo_builder.evaluate_memoized(*gate12, {false, false, true}));
+
+  // Test 13: Index-based arena backend
+  std::cout << "\nTest 13: Node arena" << std::endl;
+  Node_Arena &arena = builder.arena();
+  const NodeId a1 = arena.make_conjunction({arena.make_variable(1), arena.make_variable(2),
+                                            arena.make_true()});
+  const NodeId a2 = arena.import(*g2);
+  assert(a1 == a2);
+  assert(arena.make_disjunction({a1, arena.make_variable(3), a1}) ==
+         arena.make_disjunction({a2, arena.make_variable(3)}));
+  std::vector<NodeId> wide13;
+  for (int i = 0; i < 60; ++i)
+    wide13.push_back(arena.make_variable(30 - i % 30));
+  const NodeId w13 = arena.make_conjunction(wide13);
+  wide13.resize(30);
+  assert(arena.make_conjunction(wide13) == w13 && arena.arity(w13) == 30);
+  const NodeId a11 = arena.import(*f11);
+  const Arena_Formula handle11(arena, a11);
+  std::cout << "Arena formula: " << handle11 << std::endl;
+  assert(handle11.arity() == f11->arity());
+  for (const auto &model : models11) {
+    assert(handle11.evaluation(model) == builder.evaluate(f11, model));
+  }
+  assert(arena.evaluate_batch(a11, packed11) == builder.evaluate_batch(f11, packed11));
+  auto exported11 = arena.export_formula(a11, builder);
+  assert(*exported11 == *builder.simplify(f11));
+  assert(arena.import(*exported11) == a11);
+  assert(arena.evaluate(arena.import(*chain12), {false, true, true}));
+  // printed like print_formula: shared gates once, deep chains without recursion
+  std::ostringstream text13, exported_text13;
+  text13 << handle11;
+  print_formula(exported_text13, *exported11);
+  assert(text13.str() == exported_text13.str());
+  const NodeId g13 = arena.make_conjunction({arena.make_variable(1), arena.make_variable(2)});
+  const NodeId s13 = arena.make_conjunction(
+      {arena.make_disjunction({g13, arena.make_variable(3)}),
+       arena.make_disjunction({g13, arena.make_variable(4)})});
+  text13.str("");
+  text13 << Arena_Formula(arena, s13);
+  assert(text13.str() == "let n1 = AND[x1, x2] in AND[OR[n1, x3], OR[n1, x4]]");
+  NodeId deep13 = arena.make_variable(1);
+  for (int i = 0; i < 200000; ++i) {
+    const NodeId leaf = arena.make_variable(2 + i % 2);
+    deep13 = i % 2 ? arena.make_conjunction({deep13, leaf})
+                   : arena.make_disjunction({deep13, leaf});
+  }
+  text13.str("");
+  text13 << Arena_Formula(arena, deep13);
+  assert(text13.str().size() > 200000 * 6 && text13.str().substr(0, 7) == "AND[OR[");
+
+  // Test 14: Parallel simplify through the process-wide cache
+  std::cout << "\nTest 14: Parallel simplify" << std::endl;
+  builder.clear_cache();
+  std::vector<std::shared_ptr<Logic_Node>> results14(4);
+  std::vector<std::thread> threads14;
+  for (size_t t = 0; t < results14.size(); ++t) {
+    threads14.emplace_back([&results14, t]() {
+      // each thread builds its own copy of the same formula
+      Logic_Builder local;
+      std::shared_ptr<Logic_Node> f = local.make_variable(1);
+      for (int i = 2; i < 200; ++i) {
+        f = local.make_disjunction(
+            {local.make_conjunction({f, local.make_variable(i), local.make_true()}),
+             local.make_variable(-i)});
+      }
+      results14[t] = local.simplify(f);
+    });
+  }
+  for (auto &thread : threads14) thread.join();
+  for (const auto &result : results14) {
+    assert(result == results14[0]); // perfect sharing across threads
+  }
+  Logic_Builder private_builder;
+  private_builder.set_cache_scope(Cache_Scope::BUILDER);
+  auto own14 = private_builder.simplify(g1);
+  assert(own14 != builder.simplify(g1) && *own14 == *builder.simplify(g1));
+
+  // Test 15: Bounded simplifier cache
+  std::cout << "\nTest 15: Bounded simplifier cache" << std::endl;
+  for (auto policy : {Eviction_Policy::LRU, Eviction_Policy::CLOCK}) {
+    Logic_Builder bounded;
+    bounded.set_cache_scope(Cache_Scope::BUILDER);
+    bounded.cache().set_memory_budget(64 * 1024, policy);
+    std::shared_ptr<Logic_Node> f, simplified15;
+    for (int i = 1; i < 2000; ++i) {
+      f = bounded.make_disjunction(
+          {bounded.make_conjunction({bounded.make_variable(i), bounded.make_true()}),
+           bounded.make_variable(-i - 1)});
+      simplified15 = bounded.simplify(f);
+      assert(*simplified15 == *builder.simplify(f)); // eviction keeps results correct
+    }
+    Cache_Statistics stats15 = bounded.cache().statistics();
+    assert(stats15.evictions > 0);
+    assert(stats15.bytes <= stats15.budget);
+    assert(stats15.entries == stats15.insertions - stats15.evictions);
+    bounded.cache().reset_statistics();
+    bounded.simplify(simplified15);
+    assert(bounded.cache().statistics().hits + bounded.cache().statistics().misses > 0);
+    // shrinking the budget evicts right away
+    bounded.cache().set_memory_budget(1, policy);
+    assert(bounded.cache().size() == 0);
+    // a key changed in place by normalize is still evicted
+    bounded.cache().set_memory_budget(0, Eviction_Policy::NONE);
+    auto key15 = bounded.make_conjunction({bounded.make_variable(1), bounded.make_variable(1)});
+    bounded.simplify(key15);
+    bounded.normalize(key15);
+    bounded.cache().set_memory_budget(1, policy);
+    assert(bounded.cache().size() == 0);
+  }
+
+  // Test 16: Formulas far deeper than the call stack
+  std::cout << "\nTest 16: Deep formulas" << std::endl;
+  {
+    Logic_Builder deep;
+    deep.set_cache_scope(Cache_Scope::BUILDER);
+    const int depth16 = 100000;
+    std::shared_ptr<Logic_Node> f16 = deep.make_variable(1);
+    std::shared_ptr<Logic_Node> g16 = deep.make_variable(1);
+    for (int i = 0; i < depth16; ++i) {
+      const int literal = i % 3 + 2;
+      f16 = deep.make_disjunction({deep.make_conjunction({f16, deep.make_variable(literal)}),
+                                   deep.make_false()});
+      g16 = deep.make_disjunction({deep.make_conjunction({g16, deep.make_variable(literal)}),
+                                   deep.make_false()});
+    }
+    assert(*f16 == *g16);
+    const std::vector<bool> model16{true, true, true, true};
+    assert(deep.evaluate(f16, model16));
+    assert(deep.evaluate_memoized(*f16, model16));
+    assert(deep.evaluate_batch(f16, {~uint64_t(0), 1, 3, 7}) == 1);
+    assert(deep.evaluate_wide(f16, std::vector<uint64_t>(4, 1), 1)[0] == 1);
+    assert(deep.collect_children(f16).size() == 1 + 2 * size_t(depth16));
+    auto simplified16 = deep.simplify(f16);
+    assert(simplified16->arity() == 2 && deep.evaluate(simplified16, model16));
+    deep.normalize(g16);
+    assert(*g16 == *simplified16);
+  }
+
+  // Test 17: Shared subformulas are visited once
+  std::cout << "\nTest 17: DAG traversal" << std::endl;
+  std::shared_ptr<Logic_Node> f17 = builder.make_variable(1);
+  for (int i = 2; i < 62; ++i) {
+    f17 = builder.make_conjunction(
+        {f17, builder.make_disjunction({f17, builder.make_variable(i)})});
+  }
+  // one path per subset of the levels, but only three new nodes per level
+  assert(builder.collect_children(f17).size() == 1 + 3 * 60);
+  assert(builder.dag_size(*f17) == 1 + 3 * 60);
+  std::vector<const Logic_Node *> post17;
+  for_each_node(*f17, Visit_Order::POST_ORDER, [&](const Logic_Node &n) {
+    if (const Gate *gate = as_gate(n)) {
+      for (const auto &child : gate->getChildren()) {
+        assert(std::find(post17.begin(), post17.end(), child.get()) != post17.end());
+      }
+      // nested traversals get their own marks
+      assert(builder.dag_size(n) <= post17.size() + 1);
+    }
+    post17.push_back(&n);
+  });
+  assert(post17.size() == 1 + 3 * 60 && post17.back() == f17.get());
+
+  // Test 18: BDDs are canonical
+  std::cout << "\nTest 18: BDDs" << std::endl;
+  Bdd_Manager bdd;
+  auto x18 = builder.make_variable(1), y18 = builder.make_variable(2);
+  auto f18 = builder.make_conjunction(
+      {builder.make_disjunction({x18, y18}), builder.make_disjunction({x18, builder.make_variable(-2)})});
+  assert(bdd.from_formula(*f18) == bdd.from_formula(*x18)); // (x | y) & (x | -y) = x
+  assert(bdd.equivalent(*builder.make_conjunction({x18, y18}), *builder.make_conjunction({y18, x18})));
+  assert(!bdd.equivalent(*builder.make_conjunction({x18, y18}), *builder.make_disjunction({y18, x18})));
+  assert(bdd.model_count(bdd.from_formula(*builder.make_disjunction({x18, y18}))) == 3);
+  assert(bdd.equivalent(*f9, *builder.simplify(f9)));
+  const BddId b18 = bdd.from_formula(*f9);
+  assert(bdd.from_formula(*bdd.to_formula(b18, builder)) == b18);
+  const size_t live18 = bdd.size();
+  bdd.from_formula(*f11);
+  bdd.collect_garbage({b18});
+  assert(bdd.size() <= live18 && bdd.from_formula(*f9) == b18);
+  auto order18 = Bdd_Manager::variable_order({f9}, Bdd_Ordering::FIRST_OCCURRENCE);
+  assert((order18 == std::vector<int>{1, 2, 3, 4}));
+
+  // Test 19: CDCL solver and SAT equivalence
+  std::cout << "\nTest 19: SAT" << std::endl;
+  Sat_Solver pigeons; // 4 pigeons do not fit in 3 holes
+  auto hole19 = [](int p, int h) { return 3 * p + h + 1; };
+  for (int p = 0; p < 4; ++p)
+    pigeons.add_clause({hole19(p, 0), hole19(p, 1), hole19(p, 2)});
+  for (int h = 0; h < 3; ++h)
+    for (int p = 0; p < 4; ++p)
+      for (int q = p + 1; q < 4; ++q)
+        pigeons.add_clause({-hole19(p, h), -hole19(q, h)});
+  assert(pigeons.solve() == Sat_Result::UNSATISFIABLE);
+  Sat_Solver chain19;
+  chain19.add_clause({1});
+  for (int v = 1; v < 50; ++v)
+    chain19.add_clause({-v, v + 1});
+  chain19.add_clause({-50, -25, 7});
+  assert(chain19.solve() == Sat_Result::SATISFIABLE && chain19.value(50) && chain19.value(7));
+  assert(sat_equivalence(*f18, *x18).verdict == Equivalence::EQUIVALENT);
+  assert(sat_equivalence(*f9, *builder.simplify(f9)).verdict == Equivalence::EQUIVALENT);
+  auto and19 = builder.make_conjunction({x18, y18}), or19 = builder.make_disjunction({x18, y18});
+  const Equivalence_Check check19 = sat_equivalence(*and19, *or19);
+  assert(check19.verdict == Equivalence::DIFFERENT);
+  assert(builder.evaluate(and19, check19.counterexample) !=
+         builder.evaluate(or19, check19.counterexample));
+
+  // Test 20: DIMACS export, with and without Plaisted-Greenbaum
+  std::cout << "\nTest 20: DIMACS export" << std::endl;
+  auto solve20 = [](const std::string &cnf, size_t &clauses) {
+    std::istringstream in(cnf);
+    std::string line;
+    Sat_Solver solver;
+    std::vector<int> clause;
+    clauses = 0;
+    while (std::getline(in, line)) {
+      if (line.empty() || line[0] == 'c' || line[0] == 'p')
+        continue;
+      std::istringstream literals(line);
+      clause.clear();
+      for (int l; literals >> l && l;)
+        clause.push_back(l);
+      solver.add_clause(clause);
+      ++clauses;
+    }
+    return solver.solve();
+  };
+  auto contradiction20 = builder.make_conjunction(
+      {builder.make_disjunction({x18, y18}), builder.make_variable(-1), builder.make_variable(-2)});
+  size_t full20 = 0, pg20 = 0;
+  for (bool pg : {false, true}) {
+    for (const auto &f : {f9, contradiction20}) {
+      std::ostringstream out;
+      const Cnf_Statistics statistics = write_dimacs(out, *f, pg);
+      size_t clauses;
+      const Sat_Result result = solve20(out.str(), clauses);
+      assert(clauses == statistics.clauses);
+      assert(out.str().find("p cnf " + std::to_string(statistics.variables) + " " +
+                            std::to_string(clauses) + "\n") != std::string::npos);
+      assert((result == Sat_Result::SATISFIABLE) == (f == f9));
+      (pg ? pg20 : full20) += clauses;
+    }
+  }
+  assert(pg20 < full20);
+
+  // Test 21: Parsing the printed format back
+  std::cout << "\nTest 21: Parser" << std::endl;
+  {
+    Logic_Builder consing(true);
+    Formula_Parser parser(consing);
+    for (const auto &f : {f9, f11, contradiction20}) {
+      std::ostringstream printed;
+      printed << *f;
+      auto parsed = parser.parse(printed.str());
+      assert(parsed && !parser.failed());
+      assert(sat_equivalence(*f, *parsed).verdict == Equivalence::EQUIVALENT);
+      // hash-consing makes the shared subformulas of the text shared again
+      assert(consing.dag_size(*parsed) <= builder.dag_size(*f));
+    }
+    auto spaced21 = parser.parse("  AND [ x1 ,OR[x-2,\tTrue], OR[] ]\n");
+    assert(spaced21 && *spaced21 == *consing.make_false());
+    auto all21 = parser.parse_all("x1\nAND[x1, x2]\n\nOR[x-1, x3]\n");
+    assert(all21.size() == 3 && !parser.failed() && all21[1]->arity() == 2);
+
+    auto error21 = [&parser](const std::string &text, size_t line, size_t column) {
+      assert(!parser.parse(text) && parser.failed());
+      assert(parser.error().line == line && parser.error().column == column);
+    };
+    error21("AND[x1,, x2]", 1, 8);
+    error21("OR[x1", 1, 6);
+    error21("AND[x1,\n  FOO]", 2, 3);
+    error21("AND[x1, x0]", 1, 10);
+    error21("AND[x1] x2", 1, 9);
+    error21("AND[x1, ]", 1, 9);
+    error21("OR x1", 1, 4);
+    error21("", 1, 1);
+    assert(parser.parse_all("x1\nx2\nAND[").size() == 2 && parser.error().line == 3);
+
+    // nesting far deeper than the call stack
+    const int depth21 = 100000;
+    std::string deep21;
+    for (int i = 0; i < depth21; ++i)
+      deep21 += "AND[x1, OR[x2, ";
+    deep21 += "x3" + std::string(2 * depth21, ']');
+    auto parsed21 = parser.parse(deep21);
+    assert(parsed21 && consing.dag_size(*parsed21) == 3 + 2 * size_t(depth21));
+  }
+
+  // Test 22: Binary DAG files
+  std::cout << "\nTest 22: Binary DAG files" << std::endl;
+  {
+    // every level refers to the previous one twice: the text doubles per level
+    std::shared_ptr<Formula> ladder22 = builder.make_variable(5);
+    for (int level = 0; level < 40; ++level)
+      ladder22 = builder.make_conjunction(
+          {ladder22, builder.make_disjunction({ladder22, builder.make_variable(-(level % 4 + 1))})});
+    const std::vector<std::shared_ptr<Formula>> roots22 = {f9, ladder22, f9, builder.make_false()};
+    std::ostringstream out22;
+    const Dag_Statistics written22 = write_dag(out22, roots22);
+    const std::string bytes22 = out22.str();
+    assert(written22.bytes == bytes22.size() && bytes22.size() < 400);
+    assert(written22.nodes == builder.dag_size(*f9) + builder.dag_size(*ladder22) + 1);
+
+    const Dag_Reader reader22(bytes22);
+    assert(reader22.valid() && reader22.node_count() == written22.nodes);
+    assert(reader22.root_count() == 4 && reader22.edge_count() == written22.edges);
+    std::vector<uint64_t> batch22;
+    for (const auto &model : models9) {
+      const std::vector<bool> values = reader22.evaluate(model);
+      for (size_t r = 0; r < roots22.size(); ++r)
+        assert(values[r] == builder.evaluate(roots22[r], model));
+    }
+    const std::vector<uint64_t> packed22 = Logic_Builder::pack_models(models9);
+    const std::vector<uint64_t> batches22 = reader22.evaluate_batch(packed22);
+    for (size_t r = 0; r < roots22.size(); ++r)
+      assert(batches22[r] == builder.evaluate_batch(roots22[r], packed22));
+
+    Logic_Builder plain22;
+    const auto loaded22 = reader22.load(plain22);
+    assert(loaded22.size() == 4 && loaded22[0] == loaded22[2]);
+    assert(*loaded22[0] == *f9 && plain22.dag_size(*loaded22[1]) == builder.dag_size(*ladder22));
+    assert(sat_equivalence(*loaded22[1], *ladder22).verdict == Equivalence::EQUIVALENT);
+
+    const std::string path22 = (std::filesystem::temp_directory_path() / "logic_main_22.dag").string();
+    std::ofstream(path22, std::ios::binary) << bytes22;
+    const Dag_Reader mapped22 = Dag_Reader::map_file(path22);
+    assert(mapped22.valid() && mapped22.evaluate(models9[5]) == reader22.evaluate(models9[5]));
+    std::filesystem::remove(path22);
+    assert(!Dag_Reader::map_file(path22).valid());
+
+    assert(!Dag_Reader(bytes22.substr(0, bytes22.size() - 1)).valid());
+    assert(!Dag_Reader(bytes22 + '\0').valid());
+    std::string corrupt22 = bytes22;
+    corrupt22[0] = 'X';
+    assert(!Dag_Reader(corrupt22).valid());
+    corrupt22 = bytes22;
+    corrupt22.back() = char(0x7f); // child delta past the first node
+    assert(!Dag_Reader(corrupt22).valid());
+  }
+
+  // Test 23: Printing shared subformulas once
+  std::cout << "\nTest 23: Shared printing" << std::endl;
+  {
+    auto text23 = [](const Formula &f, const Print_Options &options) {
+      std::ostringstream out;
+      out << formula_text(f, options);
+      return out.str();
+    };
+    auto g23 = builder.make_disjunction({builder.make_variable(1), builder.make_variable(2)});
+    auto f23 = builder.make_conjunction({g23, builder.make_disjunction({g23, builder.make_variable(3)})});
+    std::ostringstream tree23;
+    tree23 << *f23;
+    assert(tree23.str() == "AND[OR[x1, x2], OR[OR[x1, x2], x3]]");
+    assert(text23(*f23, {.share = false}) == tree23.str());
+    assert(text23(*f23, {}) == "let n1 = OR[x1, x2] in AND[n1, OR[n1, x3]]");
+    assert(text23(*f23, {.share = false, .max_depth = 1}) == "AND[OR[...], OR[...]]");
+    const std::string cut23 = text23(*f23, {.share = false, .max_length = 12});
+    assert(cut23.size() < tree23.str().size() && cut23.ends_with("...") &&
+           tree23.str().starts_with(cut23.substr(0, cut23.size() - 3)));
+
+    // the tree form doubles per level, the shared form grows linearly
+    std::shared_ptr<Formula> ladder23 = builder.make_variable(5);
+    for (int level = 0; level < 40; ++level)
+      ladder23 = builder.make_conjunction(
+          {ladder23, builder.make_disjunction({ladder23, builder.make_variable(-(level % 4 + 1))})});
+    const std::string shared23 = text23(*ladder23, {});
+    assert(shared23.size() < 40 * 50);
+    Logic_Builder plain23;
+    Formula_Parser parser23(plain23);
+    auto parsed23 = parser23.parse(shared23);
+    // leaves are printed at each use, only x5 had two parents
+    assert(parsed23 && plain23.dag_size(*parsed23) == builder.dag_size(*ladder23) + 1);
+    assert(sat_equivalence(*parsed23, *ladder23).verdict == Equivalence::EQUIVALENT);
+    assert(*parser23.parse(text23(*f23, {})) == *f23);
+
+    assert(!parser23.parse("let n1 = x1 in AND[n1, n2]") && parser23.error().column == 24);
+    assert(!parser23.parse("let n1 = x1 in let n1 = x2 in n1") && parser23.error().column == 20);
+    assert(!parser23.parse("let n1 = x1 n1") && parser23.error().column == 13);
+    assert(parser23.parse_all("let n1 = x1 in OR[n1]\nn1").size() == 1 && parser23.failed());
+  }
+
+  // Test 24: Asynchronous file logger
+  std::cout << "\nTest 24: File logger" << std::endl;
+  {
+    const std::string path24 = (std::filesystem::temp_directory_path() / "logic_main_24.log").string();
+    auto count24 = [&path24]() {
+      std::ifstream in(path24);
+      size_t lines = 0;
+      for (std::string line; std::getline(in, line);)
+        lines += line.starts_with("message ");
+      return lines;
+    };
+    auto run24 = [](Logger &logger) {
+      std::vector<std::thread> threads;
+      for (int t = 0; t < 4; ++t)
+        threads.emplace_back([&logger, t]() {
+          for (int i = 0; i < 5000; ++i)
+            logger.log("message " + std::to_string(t) + " " + std::to_string(i));
+        });
+      for (auto &thread : threads)
+        thread.join();
+    };
+    {
+      FileLogger blocking24(path24, {.capacity = 64});
+      assert(blocking24.is_open());
+      run24(blocking24);
+      blocking24.flush();
+      assert(count24() == 20000 && blocking24.dropped() == 0);
+      blocking24.log("message after the flush");
+    }
+    assert(count24() == 20001); // the destructor drains the ring
+    {
+      FileLogger dropping24(path24, {.capacity = 8, .overflow = Overflow_Policy::DROP_AND_REPORT});
+      run24(dropping24);
+      dropping24.flush();
+      assert(count24() + dropping24.dropped() == 20000);
+    }
+    std::filesystem::remove(path24);
+    assert(!FileLogger("/nonexistent/logic_main_24.log").is_open());
+  }
+
+  // Test 25: Leveled logging formats nothing below the level
+  std::cout << "\nTest 25: Leveled logging" << std::endl;
+  {
+    struct Recording_Logger : Logger {
+      std::vector<std::string> lines;
+      void log(const std::string &message) override { lines.push_back(message); }
+    };
+    auto recorder25 = std::make_shared<Recording_Logger>();
+    int formatted25 = 0;
+    auto costly25 = [&formatted25]() { return ++formatted25; };
+    recorder25->set_level(Log_Level::INFO);
+    LOGIC_DEBUG(recorder25, "value ", costly25());
+    LOGIC_WARNING(recorder25, "value ", costly25(), ' ', std::hex, 255);
+    LOGIC_INFO(recorder25, "value ", costly25());
+    assert(formatted25 == 2);
+    assert((recorder25->lines == std::vector<std::string>{"value 1 ff", "value 2"}));
+    std::shared_ptr<Logger> none25;
+    LOGIC_ERROR(none25, costly25());
+    Logger *silent25 = new SilentLogger();
+    LOGIC_ERROR(silent25, costly25());
+    delete silent25;
+    assert(formatted25 == 2);
+
+    Logic_Builder logged25;
+    logged25.set_logger(recorder25);
+    logged25.simplify(f9);
+    assert(recorder25->lines.size() == 2);
+    recorder25->set_level(Log_Level::DEBUG);
+    logged25.simplify(f9);
+    assert(recorder25->lines.size() == 4 && recorder25->lines.back().starts_with("simplified OR["));
+  }
+
+  // Test 26: Instrumentation counters and timers
+  std::cout << "\nTest 26: Instrumentation" << std::endl;
+  if constexpr (instrumentation::enabled) {
+    instrumentation::reset();
+    Logic_Builder consing26(true);
+    auto x26 = consing26.make_variable(1);
+    consing26.make_variable(1);
+    consing26.make_conjunction({x26, consing26.make_variable(2)});
+    consing26.make_conjunction({x26, consing26.make_variable(2)});
+    Instrumentation_Snapshot counts26 = instrumentation::snapshot();
+    assert(counts26.counter(Counter::NODES_ALLOCATED) == 3);
+    assert(counts26.counter(Counter::UNIQUE_TABLE_HITS) == 3);
+
+    auto dup26 = builder.make_conjunction({builder.make_variable(7), builder.make_variable(7),
+                                           builder.make_variable(8)});
+    builder.normalize(dup26);
+    builder.clear_cache();
+    builder.simplify(f9);
+    builder.simplify(f9);
+    // a thread that has exited still counts
+    std::thread([&builder, &f9]() { builder.evaluate(f9, {true, false, true, false}); }).join();
+    counts26 = instrumentation::snapshot();
+    assert(counts26.counter(Counter::NORMALIZE_DUPLICATES_REMOVED) == 1);
+    assert(counts26.counter(Counter::SIMPLIFY_CACHE_HITS) >= 1);
+    assert(counts26.counter(Counter::SIMPLIFY_CACHE_HITS) <
+           counts26.counter(Counter::SIMPLIFY_CACHE_LOOKUPS));
+    assert(counts26.timer(Timer::SIMPLIFY).calls == 2 && counts26.timer(Timer::NORMALIZE).calls == 1);
+    assert(counts26.timer(Timer::EVALUATE).calls == 1);
+    assert(counts26.timer(Timer::SIMPLIFY).max_ns <= counts26.timer(Timer::SIMPLIFY).total_ns);
+    const std::string json26 = counts26.json();
+    assert(json26.starts_with("{\"enabled\": true, \"counters\": {\"nodes_allocated\": "));
+    assert(json26.find("\"simplify\": {\"calls\": 2, ") != std::string::npos);
+    instrumentation::reset();
+    assert(instrumentation::snapshot().counter(Counter::NODES_ALLOCATED) == 0);
+  }
+
+  // Test 27: Synthetic workloads
+  std::cout << "\nTest 27: Workload generator" << std::endl;
+  {
+    // parents of each gate, and the longest path to a leaf
+    auto shape27 = [](const Formula &root, std::unordered_map<const Logic_Node *, size_t> &parents) {
+      std::unordered_map<const Logic_Node *, size_t> height;
+      for_each_node(root, Visit_Order::POST_ORDER, [&](const Logic_Node &n) {
+        size_t h = 0;
+        if (const Gate *gate = as_gate(n)) {
+          for (const auto &child : gate->getChildren()) {
+            h = std::max(h, height[child.get()] + 1);
+            if (child->isGate())
+              ++parents[child.get()];
+          }
+        }
+        height[&n] = h;
+      });
+      return height[&root];
+    };
+
+    const Workload_Options tree27{.gates = 600, .depth = 30, .sharing = 0, .seed = 5};
+    Logic_Builder plain27;
+    auto f27 = generate_workload(plain27, tree27);
+    assert(*f27 == *generate_workload(plain27, tree27));
+    std::unordered_map<const Logic_Node *, size_t> parents27;
+    // the chains of gates, the root on top and the leaves below
+    assert(shape27(*f27, parents27) == 31);
+    assert(parents27.size() == 600);
+    for (const auto &[gate, count] : parents27)
+      assert(count == 1 && gate->arity() >= 2 && gate->arity() <= 4);
+
+    Workload_Options wide27{.gates = 4000, .depth = 50, .min_fan_in = 2, .max_fan_in = 64,
+                            .fan_in = Fan_In_Distribution::GEOMETRIC, .variables = 20,
+                            .sharing = 0.5, .seed = 6};
+    auto g27 = generate_workload(plain27, wide27);
+    parents27.clear();
+    assert(shape27(*g27, parents27) == 51 && parents27.size() == 4000);
+    size_t shared27 = 0, widest27 = 0;
+    for (const auto &[gate, count] : parents27) {
+      shared27 += count >= 2;
+      widest27 = std::max(widest27, gate->arity());
+    }
+    assert(shared27 > 400 && widest27 > 6 && widest27 <= 64);
+
+    // deterministic bytes, and the same function in both formats
+    std::ostringstream binary27, again27, text27;
+    write_workload(binary27, wide27, Workload_Format::BINARY);
+    write_workload(again27, wide27, Workload_Format::BINARY);
+    write_workload(text27, wide27, Workload_Format::TEXT);
+    const std::string bytes27 = binary27.str();
+    assert(bytes27 == again27.str());
+    const Dag_Reader reader27(bytes27);
+    assert(reader27.valid() && reader27.root_count() == 1);
+    Logic_Builder consing27(true);
+    Formula_Parser parser27(consing27);
+    const auto parsed27 = parser27.parse_all(text27.str());
+    assert(!parser27.failed() && parsed27.size() == 1);
+    Random random27(27);
+    for (int round = 0; round < 32; ++round) {
+      std::vector<bool> model27(20);
+      for (size_t i = 0; i < model27.size(); ++i)
+        model27[i] = random27.generate_bool();
+      const bool value27 = reader27.evaluate(model27)[0];
+      assert(value27 == plain27.evaluate_memoized(*g27, model27));
+      assert(value27 == consing27.evaluate_memoized(*parsed27[0], model27));
+    }
+
+    wide27.seed = 7;
+    std::ostringstream other27;
+    write_workload(other27, wide27, Workload_Format::BINARY);
+    assert(other27.str() != bytes27);
+  }
+
+  // Test 28: Normalizing a shared gate keeps the hashes of its ancestors valid
+  std::cout << "\nTest 28: Hashes after normalize" << std::endl;
+  {
+    Logic_Builder plain28;
+    auto c28 = plain28.make_conjunction(
+        {plain28.make_variable(1), plain28.make_variable(1), plain28.make_variable(2)});
+    auto p28 = plain28.make_disjunction({c28, plain28.make_variable(2)});
+    // a chain above the shared gate, outside of the normalized formula
+    std::shared_ptr<Formula> deep28 = p28;
+    for (int i = 0; i < 100000; ++i)
+      deep28 = plain28.make_conjunction({deep28, plain28.make_variable(3)});
+    const size_t hash28 = c28->hash();
+    plain28.normalize(c28);
+    assert(c28->arity() == 2 && c28->hash() == hash28);
+    auto q28 = plain28.make_disjunction(
+        {plain28.make_conjunction({plain28.make_variable(1), plain28.make_variable(2)}),
+         plain28.make_variable(2)});
+    assert(*p28 == *q28);
+    assert(Logic_Node_Hash()(p28) == Logic_Node_Hash()(q28));
+    Logic_Builder consing28(true);
+    assert(consing28.simplify(p28) == consing28.simplify(q28));
+
+    std::shared_ptr<Formula> other28 = q28;
+    for (int i = 0; i < 100000; ++i)
+      other28 = plain28.make_conjunction({other28, plain28.make_variable(3)});
+    assert(deep28->hash() == other28->hash());
+  }
+
+  // Test 29: Differences beyond the truth tables are found by SAT
+  std::cout << "\nTest 29: SAT counterexample in the fuzzer" << std::endl;
+  {
+    // 30 variables are over the exhaustive limit, and the formulas differ on
+    // 2 of 2^30 models, which sampling misses
+    struct Probe : Fuzzer {
+      using Fuzzer::Fuzzer;
+      using Fuzzer::test_same_models;
+    } probe29(29, 30, 0);
+    probe29.keep_going();
+    Logic_Builder builder29;
+    std::vector<std::shared_ptr<Formula>> all29, last_negated29;
+    for (int i = 1; i <= 30; ++i) {
+      all29.push_back(builder29.make_variable(i));
+      last_negated29.push_back(builder29.make_variable(i < 30 ? i : -i));
+    }
+    const auto f29 = builder29.make_conjunction(all29);
+    probe29.test_same_models(f29, builder29.make_conjunction(all29));
+    assert(probe29.errors() == 0);
+    probe29.test_same_models(f29, builder29.make_conjunction(last_negated29));
+    assert(probe29.errors() == 1);
+    assert(probe29.sat_unknowns() == 0);
+
+    // a check that gives up proves nothing, it is counted
+    Probe limited29(29, 30, 0, {.sat_conflict_limit = 0});
+    limited29.keep_going();
+    const uint64_t unknown29 = instrumentation::snapshot().counter(Counter::FUZZ_SAT_UNKNOWN);
+    limited29.test_same_models(f29, builder29.make_conjunction(all29));
+    assert(limited29.errors() == 0 && limited29.sat_unknowns() == 1);
+    assert(instrumentation::snapshot().counter(Counter::FUZZ_SAT_UNKNOWN) ==
+           unknown29 + (instrumentation::enabled ? 1 : 0));
+  }
+
   std::cout << "\nAll tests passed!" << std::endl;
   return 0;
 }
\ No newline at end of file
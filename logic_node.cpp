@@ -1,30 +1,192 @@
 #include "logic_node.hpp"
+#include "formula_printer.hpp"
 #include "logic_builder.hpp"
+#include "traversal.hpp"
+
+#include <atomic>
+#include <bit>
+#include <iterator>
+#include <tuple>
 
 // TODO exercise 0, 1, 2, and 5
-// Stream operator implementation
-std::ostream &operator<<(std::ostream &stream, const Logic_Node &n) {
-    // Basic implementation for now
-    if (dynamic_cast<const Constant*>(&n)) {
-        stream << (dynamic_cast<const Constant*>(&n)->getValue() ? "True" : "False");
-    } else if (dynamic_cast<const Variable*>(&n)) {
-        stream << "x" << dynamic_cast<const Variable*>(&n)->getLiteral();
-    } else if (const Gate* gate = dynamic_cast<const Gate*>(&n)) {
-        stream << (gate->getType() == Gate_Type::AND_GATE ? "AND[" : "OR[");
-        const auto& children = gate->getChildren();
-        for (size_t i = 0; i < children.size(); ++i) {
-            if (i > 0) stream << ", ";
-            stream << *children[i];
+namespace {
+
+// Evaluation of gates on a stack of values, one word of 64 models per level.
+// A gate starts from its neutral element and every finished child is combined
+// into it, skipping the remaining children once the value is decided.
+template <typename Leaf>
+struct Evaluation_Visitor {
+    Leaf leaf;
+    std::vector<uint64_t> values;
+
+    bool enter(const Logic_Node &n) {
+        if (!n.isGate()) {
+            values.push_back(leaf(n));
+            return false;
         }
-        stream << "]";
-    } else {
-        stream << "Unknown";
+        values.push_back(n.getKind() == Node_Kind::AND_GATE ? ~uint64_t(0) : 0);
+        return true;
+    }
+    bool child_done(const Logic_Node &parent, size_t) {
+        const uint64_t child = values.back();
+        values.pop_back();
+        if (parent.getKind() == Node_Kind::AND_GATE) {
+            return (values.back() &= child) != 0; // all models are already false
+        }
+        return ~(values.back() |= child) != 0; // all models are already true
     }
+    void leave(const Logic_Node &) {}
+};
+
+template <typename Leaf>
+uint64_t evaluate_gate(const Gate &gate, Leaf leaf) {
+    Evaluation_Visitor<Leaf> visitor{leaf, {}};
+    walk_formula(gate, visitor);
+    return visitor.values.back();
+}
+
+} // namespace
+
+// Stream operator implementation: the tree form, see formula_printer.hpp for
+// the shared form and the caps
+std::ostream &operator<<(std::ostream &stream, const Logic_Node &n) {
+    print_formula(stream, n, {.share = false});
     return stream;
 }
 
+// 64 bits cannot wrap around within the lifetime of a process
+static std::atomic<uint64_t> next_node_id{0};
+
+Logic_Node::Logic_Node(Node_Kind kind, size_t hash)
+    : node_kind(kind), id(next_node_id.fetch_add(1, std::memory_order_relaxed)),
+      hash_value(hash) {}
+
+// Batch evaluation, dispatched on the kind tag rather than through virtual
+// calls. AND/OR gates combine 64 models per child with a single & or |, see
+// Evaluation_Visitor.
+uint64_t Logic_Node::evaluation_batch(const std::vector<uint64_t> &inputs) const {
+    switch (node_kind) {
+    case Node_Kind::CONSTANT:
+        return static_cast<const Constant*>(this)->getValue() ? ~uint64_t(0) : 0;
+    case Node_Kind::VARIABLE: {
+        const int literal = static_cast<const Variable*>(this)->getLiteral();
+        const int index = abs(literal) - 1;
+        // Same convention as Variable::evaluation for out-of-range literals
+        if (index < 0 || index >= static_cast<int>(inputs.size())) {
+            return 0;
+        }
+        return literal > 0 ? inputs[index] : ~inputs[index];
+    }
+    case Node_Kind::AND_GATE:
+    case Node_Kind::OR_GATE:
+        break;
+    }
+    return evaluate_gate(static_cast<const Gate&>(*this), [&inputs](const Logic_Node &leaf) {
+        return leaf.evaluation_batch(inputs);
+    });
+}
+
+// Structural hashes. Gates combine the stored hashes of their children, so
+// hashing a node never walks the subtree.
+static size_t constant_hash(bool value) { return value ? 1 : 0; }
+
+static size_t variable_hash(int literal) {
+    return std::hash<int>()(literal) * 31;
+}
+
+namespace {
+
+// Child hashes already combined into the hash of a gate. Narrow gates test a
+// 64-bit filter and only scan on a hit. Wide ones use an open-addressing table
+// kept between the calls of a thread and emptied by bumping an epoch.
+class Seen_Hashes {
+public:
+    explicit Seen_Hashes(size_t arity)
+        : wide(arity > narrow_limit), mask(std::bit_ceil(2 * arity) - 1),
+          shift(64 - std::countr_zero(mask + 1)) {
+        if (!wide) {
+            return;
+        }
+        if (slots.size() <= mask) {
+            slots.assign(mask + 1, Slot());
+            epoch = 0;
+        }
+        if (++epoch == 0) {
+            // on wrap-around old stamps could alias the new epoch
+            std::fill(slots.begin(), slots.end(), Slot());
+            epoch = 1;
+        }
+    }
+
+    // Adds `hash`, returns false if it was seen already
+    bool insert(size_t hash) {
+        const size_t mixed = hash * 0x9E3779B97F4A7C15ull;
+        if (!wide) {
+            const uint64_t bit = uint64_t(1) << (mixed >> 58);
+            if ((filter & bit) && std::find(narrow, narrow + count, hash) != narrow + count) {
+                return false;
+            }
+            filter |= bit;
+            narrow[count++] = hash;
+            return true;
+        }
+        for (size_t i = mixed >> shift;; i = (i + 1) & mask) {
+            Slot &slot = slots[i];
+            if (slot.epoch != epoch) {
+                slot = {hash, epoch};
+                return true;
+            }
+            if (slot.hash == hash) {
+                return false;
+            }
+        }
+    }
+
+private:
+    static constexpr size_t narrow_limit = 16;
+    struct Slot {
+        size_t hash = 0;
+        uint32_t epoch = 0; // never a live epoch
+    };
+    static inline thread_local std::vector<Slot> slots;
+    static inline thread_local uint32_t epoch = 0;
+    const bool wide;
+    const size_t mask; // only the first slots are probed, to stay in cache
+    const int shift;   // keeps the top bits of the mixed hash as the slot
+    uint64_t filter = 0;
+    size_t narrow[narrow_limit];
+    size_t count = 0;
+};
+
+} // namespace
+
+// Combines the children as Logic_Builder::normalize leaves them, see the
+// header. Children with equal hashes are treated as duplicates, which is
+// consistent with equality: equal children have equal hashes.
+size_t Gate::hash_of(Gate_Type type,
+                     const std::vector<std::shared_ptr<Logic_Node>> &children) {
+    const size_t seed = (type == Gate_Type::AND_GATE) ? 17 : 23;
+    const bool absorbing = type == Gate_Type::OR_GATE;
+    Seen_Hashes seen(children.size());
+    size_t hash_value = seed;
+    for (const auto& child : children) {
+        if (const Constant *constant = as_constant(*child)) {
+            if (constant->getValue() == absorbing) {
+                return seed * 31 + constant->hash();
+            }
+            continue;
+        }
+        const size_t hash = child->hash();
+        if (seen.insert(hash)) {
+            hash_value = hash_value * 31 + hash;
+        }
+    }
+    return hash_value;
+}
+
 // Constant implementation
-Constant::Constant(bool value) : value(value) {}
+Constant::Constant(bool value)
+    : Logic_Node(Node_Kind::CONSTANT, constant_hash(value)), value(value) {}
 
 size_t Constant::arity() const {
     return 0;
@@ -35,7 +197,7 @@ bool Constant::evaluation(const std::vector<bool> &/* inputs */) const {
 }
 
 bool Constant::operator==(const Logic_Node *const other) const {
-    if (const Constant* c = dynamic_cast<const Constant*>(other)) {
+    if (const Constant* c = as_constant(*other)) {
         return value == c->value;
     }
     return false;
@@ -51,53 +213,70 @@ bool Constant::getValue() const {
 
 // Gate implementation
 Gate::Gate(Gate_Type type, std::vector<std::shared_ptr<Logic_Node>> inputs)
-    : kind(type), children(std::move(inputs)) {}
+    : Logic_Node(type == Gate_Type::AND_GATE ? Node_Kind::AND_GATE : Node_Kind::OR_GATE,
+                 hash_of(type, inputs)),
+      children(std::move(inputs)) {}
 
 size_t Gate::arity() const {
     return children.size();
 }
 
-bool Gate::evaluation(const std::vector<bool> &inputs) const {
-    // Handle special cases: AND[] = True, OR[] = False
-    if (children.empty()) {
-        return kind == Gate_Type::AND_GATE;
-    }
-    
-    // Evaluate based on gate type
-    if (kind == Gate_Type::AND_GATE) {
-        // AND gate: all inputs must be true
-        for (const auto& child : children) {
-            if (!child->evaluation(inputs)) {
-                return false;
-            }
+Gate::~Gate() {
+    // Releasing the last reference to a deep formula would recurse once per
+    // level. Gates about to be destroyed hand their children to a worklist
+    // instead, so every node is destroyed with an empty child list.
+    std::vector<std::shared_ptr<Logic_Node>> pending = std::move(children);
+    while (!pending.empty()) {
+        std::shared_ptr<Logic_Node> node = std::move(pending.back());
+        pending.pop_back();
+        if (node.use_count() == 1 && node->isGate()) {
+            auto& grandchildren = static_cast<Gate&>(*node).children;
+            std::move(grandchildren.begin(), grandchildren.end(), std::back_inserter(pending));
+            grandchildren.clear();
         }
-        return true;
-    } else { // OR_GATE
-        // OR gate: at least one input must be true
-        for (const auto& child : children) {
-            if (child->evaluation(inputs)) {
-                return true;
-            }
-        }
-        return false;
     }
 }
 
+bool Gate::evaluation(const std::vector<bool> &inputs) const {
+    // AND[] = True and OR[] = False are the neutral elements of the visitor
+    return evaluate_gate(*this, [&inputs](const Logic_Node &leaf) {
+        return leaf.evaluation(inputs) ? ~uint64_t(0) : 0;
+    }) != 0;
+}
+
 bool Gate::operator==(const Logic_Node *const other) const {
-    if (const Gate* g = dynamic_cast<const Gate*>(other)) {
-        if (kind != g->kind || children.size() != g->children.size()) {
-            return false;
-        }
-        
-        // Check if all children match (order matters)
-        for (size_t i = 0; i < children.size(); ++i) {
-            if (!(*children[i] == *g->children[i])) {
+    // Compares both formulas in lockstep. Children that are the same pointer
+    // are equal without looking further; the other pairs are compared later
+    // from an explicit stack.
+    std::vector<std::pair<const Logic_Node*, const Logic_Node*>> pending;
+    const Logic_Node* lhs = this;
+    const Logic_Node* rhs = other;
+    for (;;) {
+        if (lhs != rhs) {
+            if (lhs->getKind() != rhs->getKind()) {
+                return false;
+            }
+            if (const Gate* a = as_gate(*lhs)) {
+                const Gate* b = static_cast<const Gate*>(rhs);
+                if (a->children.size() != b->children.size()) {
+                    return false;
+                }
+                // Check if all children match (order matters)
+                for (size_t i = a->children.size(); i-- > 0;) {
+                    if (a->children[i] != b->children[i]) {
+                        pending.emplace_back(a->children[i].get(), b->children[i].get());
+                    }
+                }
+            } else if (!(*lhs == *rhs)) {
                 return false;
             }
         }
-        return true;
+        if (pending.empty()) {
+            return true;
+        }
+        std::tie(lhs, rhs) = pending.back();
+        pending.pop_back();
     }
-    return false;
 }
 
 bool Gate::operator==(const Logic_Node &other) const {
@@ -105,7 +284,7 @@ bool Gate::operator==(const Logic_Node &other) const {
 }
 
 Gate_Type Gate::getType() const {
-    return kind;
+    return node_kind == Node_Kind::AND_GATE ? Gate_Type::AND_GATE : Gate_Type::OR_GATE;
 }
 
 const std::vector<std::shared_ptr<Logic_Node>>& Gate::getChildren() const {
@@ -116,8 +295,13 @@ std::vector<std::shared_ptr<Logic_Node>>& Gate::getChildrenMutable() {
     return children;
 }
 
+void Gate::update_hash() {
+    hash_value = hash_of(getType(), children);
+}
+
 // Variable implementation
-Variable::Variable(int literal) : literal(literal) {}
+Variable::Variable(int literal)
+    : Logic_Node(Node_Kind::VARIABLE, variable_hash(literal)), literal(literal) {}
 
 size_t Variable::arity() const {
     return 1;
@@ -134,7 +318,7 @@ bool Variable::evaluation(const std::vector<bool> &inputs) const {
 }
 
 bool Variable::operator==(const Logic_Node *const other) const {
-    if (const Variable* v = dynamic_cast<const Variable*>(other)) {
+    if (const Variable* v = as_variable(*other)) {
         return literal == v->literal;
     }
     return false;
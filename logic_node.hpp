@@ -2,6 +2,7 @@
 #define LOGIC_NODE_HPP
 
 #include <cassert>
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <iostream>
@@ -9,20 +10,49 @@
 
 class Logic_Builder;
 
+// Concrete type of a node. Hot code dispatches on this tag with a switch, or
+// with the checked downcasts as_gate, as_constant and as_variable below,
+// instead of probing the type with dynamic_cast.
+enum class Node_Kind { CONSTANT, VARIABLE, AND_GATE, OR_GATE };
+
 // Abstract base class for logic nodes (Formula)
 class Logic_Node {
 public:
   virtual ~Logic_Node() = default;
+  Node_Kind getKind() const { return node_kind; }
+  bool isGate() const {
+    return node_kind == Node_Kind::AND_GATE || node_kind == Node_Kind::OR_GATE;
+  }
   virtual size_t arity() const = 0;
 
   virtual bool evaluation(const std::vector<bool> &inputs) const = 0;
 
+  // Evaluates 64 models at once. The models are transposed and bit-packed:
+  // `inputs[i]` holds the value of variable i+1 in each of the 64 models, and
+  // bit j of the result is the value of the formula in model j.
+  uint64_t evaluation_batch(const std::vector<uint64_t> &inputs) const;
+
   // Equality operators
   virtual bool operator==(const Logic_Node *const other) const = 0;
   virtual bool operator==(const Logic_Node &other) const = 0;
 
+  // Structural hash, computed once at construction from the children's
+  // hashes. Normalization does not change it, see Gate::hash_of.
+  size_t hash() const { return hash_value; }
+
+  // Identifier unique among all nodes created by the process, never reused,
+  // hence a key that stays valid after the node is destroyed. Scratch state
+  // of a single walk is kept by address instead, see Node_Table.
+  uint64_t getId() const { return id; }
+
   friend std::ostream &operator<<(std::ostream &stream, const Logic_Node &n);
   friend class Logic_Builder;
+
+protected:
+  Logic_Node(Node_Kind kind, size_t hash);
+  const Node_Kind node_kind;
+  const uint64_t id;
+  size_t hash_value;
 };
 
 // Class representing a constant (True/False)
@@ -47,7 +77,8 @@ enum class Gate_Type { AND_GATE, OR_GATE };
 class Gate : public Logic_Node {
 public:
   Gate(Gate_Type type, std::vector<std::shared_ptr<Logic_Node>> inputs);
-  virtual ~Gate() = default;
+  // iterative, so that deep formulas can be released
+  ~Gate() override;
   
   size_t arity() const override;
   bool evaluation(const std::vector<bool> &inputs) const override;
@@ -57,9 +88,17 @@ public:
   Gate_Type getType() const;
   const std::vector<std::shared_ptr<Logic_Node>>& getChildren() const;
   std::vector<std::shared_ptr<Logic_Node>>& getChildrenMutable();
+  // Must be called after the children have been changed in place, other than
+  // by normalization
+  void update_hash();
+  // Hash of a gate with the given type and children. It is the hash of the
+  // normalized gate: neutral constants are left out, an absorbing one stands
+  // for all children, and a repeated child hash counts once. Normalizing a
+  // gate in place thus keeps the stored hashes of its ancestors valid.
+  static size_t hash_of(Gate_Type type,
+                        const std::vector<std::shared_ptr<Logic_Node>> &children);
 
 private:
-  Gate_Type kind;
   std::vector<std::shared_ptr<Logic_Node>> children;
 };
 
@@ -79,4 +118,21 @@ private:
   int literal;
 };
 
+// Checked downcasts through the kind tag. They work on raw references, hence
+// do not touch the reference count of a shared_ptr.
+inline const Gate *as_gate(const Logic_Node &n) {
+  return n.isGate() ? static_cast<const Gate *>(&n) : nullptr;
+}
+inline Gate *as_gate(Logic_Node &n) {
+  return n.isGate() ? static_cast<Gate *>(&n) : nullptr;
+}
+inline const Constant *as_constant(const Logic_Node &n) {
+  return n.getKind() == Node_Kind::CONSTANT ? static_cast<const Constant *>(&n)
+                                            : nullptr;
+}
+inline const Variable *as_variable(const Logic_Node &n) {
+  return n.getKind() == Node_Kind::VARIABLE ? static_cast<const Variable *>(&n)
+                                            : nullptr;
+}
+
 #endif // LOGIC_NODE_HPP
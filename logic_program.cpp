@@ -0,0 +1,213 @@
+#include "logic_program.hpp"
+#include "logic_node.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+// Node of the DAG being compiled, in discovery order
+struct Compile_Node {
+  const Logic_Node *node;
+  // number of parent edges, a node with exactly one is private to its parent
+  uint32_t in_degree = 0;
+  // parent through which the node was first reached
+  uint32_t parent = UINT32_MAX;
+  uint32_t slot = UINT32_MAX;
+};
+
+const std::vector<std::shared_ptr<Logic_Node>> &children_of(const Logic_Node &n) {
+  static const std::vector<std::shared_ptr<Logic_Node>> none;
+  const Gate *gate = as_gate(n);
+  return gate ? gate->getChildren() : none;
+}
+
+} // namespace
+
+Logic_Program Logic_Program::compile(const Logic_Node &f) {
+  // Discover the distinct nodes, count their parents and record a post-order.
+  // The traversal uses an explicit stack to support arbitrarily deep formulas.
+  std::vector<Compile_Node> nodes;
+  std::unordered_map<const Logic_Node *, uint32_t> ids;
+  std::vector<uint32_t> post_order;
+  std::vector<std::pair<uint32_t, size_t>> stack;
+
+  ids.emplace(&f, 0);
+  nodes.push_back({&f});
+  stack.emplace_back(0, 0);
+  while (!stack.empty()) {
+    auto &[id, next] = stack.back();
+    const auto &children = children_of(*nodes[id].node);
+    if (next == children.size()) {
+      post_order.push_back(id);
+      stack.pop_back();
+      continue;
+    }
+    const Logic_Node *child = children[next++].get();
+    auto [it, inserted] = ids.emplace(child, nodes.size());
+    if (inserted) {
+      nodes.push_back({child});
+      nodes.back().parent = id;
+      stack.emplace_back(it->second, 0);
+    }
+    ++nodes[it->second].in_degree;
+  }
+
+  // Emit one block per shared node (and the root): its private subtree in
+  // post-order. Shared descendants finish earlier in the global post-order, so
+  // every operand precedes its gate.
+  Logic_Program program;
+  program.instructions.reserve(nodes.size());
+  auto is_private = [&nodes](uint32_t id) {
+    return id && nodes[id].in_degree == 1;
+  };
+  auto emit = [&](uint32_t id) {
+    const Logic_Node &n = *nodes[id].node;
+    Instruction instruction{Opcode::CONSTANT, false, 0, 0, 0, no_jump};
+    switch (n.getKind()) {
+    case Node_Kind::CONSTANT:
+      instruction.argument = static_cast<const Constant &>(n).getValue();
+      break;
+    case Node_Kind::VARIABLE:
+      instruction.opcode = Opcode::VARIABLE;
+      instruction.argument = static_cast<const Variable &>(n).getLiteral();
+      break;
+    case Node_Kind::AND_GATE:
+    case Node_Kind::OR_GATE:
+      instruction.opcode = n.getKind() == Node_Kind::AND_GATE ? Opcode::AND_GATE
+                                                              : Opcode::OR_GATE;
+      instruction.first = program.operands.size();
+      for (const auto &child : children_of(n)) {
+        const uint32_t slot = nodes[ids.at(child.get())].slot;
+        assert(slot != UINT32_MAX);
+        program.operands.push_back(slot);
+        ++instruction.count;
+      }
+      break;
+    }
+    nodes[id].slot = program.instructions.size();
+    program.instructions.push_back(instruction);
+  };
+
+  for (uint32_t shared : post_order) {
+    if (is_private(shared))
+      continue;
+    stack.emplace_back(shared, 0);
+    while (!stack.empty()) {
+      auto &[id, next] = stack.back();
+      const auto &children = children_of(*nodes[id].node);
+      if (next == children.size()) {
+        const uint32_t done = id;
+        stack.pop_back();
+        emit(done);
+        continue;
+      }
+      const uint32_t child = ids.at(children[next++].get());
+      if (is_private(child))
+        stack.emplace_back(child, 0);
+    }
+  }
+
+  // Jumps from private nodes to their parent, kept only where there are
+  // siblings in between to skip.
+  for (uint32_t id = 1; id < nodes.size(); ++id) {
+    if (!is_private(id))
+      continue;
+    const Compile_Node &parent = nodes[nodes[id].parent];
+    Instruction &instruction = program.instructions[nodes[id].slot];
+    if (parent.slot - nodes[id].slot <= 1)
+      continue;
+    instruction.jump = parent.slot;
+    instruction.jump_value = parent.node->getKind() == Node_Kind::OR_GATE;
+  }
+
+  assert(program.instructions.size() == nodes.size());
+  program.values.resize(program.instructions.size());
+  program.batch_values.resize(program.instructions.size());
+  return program;
+}
+
+bool Logic_Program::evaluate(const std::vector<bool> &model) const {
+  const size_t n = instructions.size();
+  for (size_t pc = 0; pc < n; ++pc) {
+    const Instruction *instruction = &instructions[pc];
+    bool value = false;
+    switch (instruction->opcode) {
+    case Opcode::CONSTANT:
+      value = instruction->argument;
+      break;
+    case Opcode::VARIABLE: {
+      const int literal = instruction->argument;
+      const int index = std::abs(literal) - 1;
+      if (index >= 0 && index < static_cast<int>(model.size()))
+        value = literal > 0 ? model[index] : !model[index];
+      break;
+    }
+    case Opcode::AND_GATE: {
+      value = true;
+      const uint32_t *operand = operands.data() + instruction->first;
+      for (uint32_t i = 0; i < instruction->count && value; ++i)
+        value = values[operand[i]];
+      break;
+    }
+    case Opcode::OR_GATE: {
+      const uint32_t *operand = operands.data() + instruction->first;
+      for (uint32_t i = 0; i < instruction->count && !value; ++i)
+        value = values[operand[i]];
+      break;
+    }
+    }
+    values[pc] = value;
+    // a controlling value decides the parent, skip to it
+    while (instruction->jump != no_jump && value == instruction->jump_value) {
+      pc = instruction->jump;
+      values[pc] = value;
+      instruction = &instructions[pc];
+    }
+  }
+  return values[n - 1];
+}
+
+uint64_t Logic_Program::evaluate_batch(const std::vector<uint64_t> &models) const {
+  const size_t n = instructions.size();
+  for (size_t pc = 0; pc < n; ++pc) {
+    const Instruction *instruction = &instructions[pc];
+    uint64_t value = 0;
+    switch (instruction->opcode) {
+    case Opcode::CONSTANT:
+      value = instruction->argument ? ~uint64_t(0) : 0;
+      break;
+    case Opcode::VARIABLE: {
+      const int literal = instruction->argument;
+      const int index = std::abs(literal) - 1;
+      if (index >= 0 && index < static_cast<int>(models.size()))
+        value = literal > 0 ? models[index] : ~models[index];
+      break;
+    }
+    case Opcode::AND_GATE: {
+      value = ~uint64_t(0);
+      const uint32_t *operand = operands.data() + instruction->first;
+      for (uint32_t i = 0; i < instruction->count && value; ++i)
+        value &= batch_values[operand[i]];
+      break;
+    }
+    case Opcode::OR_GATE: {
+      const uint32_t *operand = operands.data() + instruction->first;
+      for (uint32_t i = 0; i < instruction->count && ~value; ++i)
+        value |= batch_values[operand[i]];
+      break;
+    }
+    }
+    batch_values[pc] = value;
+    // jump only if all 64 models agree on the controlling value
+    while (instruction->jump != no_jump &&
+           value == (instruction->jump_value ? ~uint64_t(0) : 0)) {
+      pc = instruction->jump;
+      batch_values[pc] = value;
+      instruction = &instructions[pc];
+    }
+  }
+  return batch_values[n - 1];
+}
@@ -0,0 +1,62 @@
+#ifndef LOGIC_PROGRAM_HPP
+#define LOGIC_PROGRAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Logic_Node;
+
+// Formula DAG compiled into a flat instruction tape
+//
+// Every distinct node appears once, after all of its operands, so the tape is
+// evaluated by a single loop over a contiguous array without pointer chasing or
+// virtual calls. Nodes with a single parent are laid out right before it,
+// together with the rest of that parent's private subtree. When such a node
+// produces the controlling value of its parent (False below AND, True below
+// OR), the interpreter jumps to the parent and skips the remaining siblings.
+//
+// Compile once (Logic_Builder::compile) and evaluate many times. The program
+// keeps its scratch values, hence one instance must not be evaluated from
+// several threads at once.
+class Logic_Program {
+public:
+  enum class Opcode : uint8_t { CONSTANT, VARIABLE, AND_GATE, OR_GATE };
+
+  static constexpr uint32_t no_jump = UINT32_MAX;
+
+  struct Instruction {
+    Opcode opcode;
+    // value that decides the parent, only meaningful with a jump
+    bool jump_value;
+    // literal of a variable, value of a constant
+    int32_t argument;
+    // operands of a gate are operands[first, first + count)
+    uint32_t first;
+    uint32_t count;
+    // instruction of the parent gate, or no_jump
+    uint32_t jump;
+  };
+
+  static Logic_Program compile(const Logic_Node &f);
+
+  // same semantics as Logic_Node::evaluation
+  bool evaluate(const std::vector<bool> &model) const;
+  // same semantics as Logic_Node::evaluation_batch
+  uint64_t evaluate_batch(const std::vector<uint64_t> &models) const;
+
+  size_t size() const { return instructions.size(); }
+  const std::vector<Instruction> &getInstructions() const {
+    return instructions;
+  }
+  const std::vector<uint32_t> &getOperands() const { return operands; }
+
+private:
+  std::vector<Instruction> instructions;
+  std::vector<uint32_t> operands;
+
+  mutable std::vector<uint8_t> values;
+  mutable std::vector<uint64_t> batch_values;
+};
+
+#endif // LOGIC_PROGRAM_HPP
@@ -0,0 +1,42 @@
+#include "mapped_file.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Mapped_File::Mapped_File(const std::string &path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    failure = path + ": " + std::strerror(errno);
+    return;
+  }
+  struct stat info;
+  if (::fstat(fd, &info) < 0) {
+    failure = path + ": " + std::strerror(errno);
+    ::close(fd);
+    return;
+  }
+  length = info.st_size;
+  if (length) {
+    data = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      failure = path + ": " + std::strerror(errno);
+      data = nullptr;
+      length = 0;
+      ::close(fd);
+      return;
+    }
+    ::madvise(data, length, MADV_SEQUENTIAL);
+  }
+  ::close(fd); // the mapping stays valid
+  opened = true;
+}
+
+Mapped_File::~Mapped_File() {
+  if (data)
+    ::munmap(data, length);
+}
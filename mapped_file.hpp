@@ -0,0 +1,30 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a whole file
+class Mapped_File {
+public:
+  explicit Mapped_File(const std::string &path);
+  ~Mapped_File();
+  Mapped_File(const Mapped_File &) = delete;
+  Mapped_File &operator=(const Mapped_File &) = delete;
+
+  bool is_open() const { return opened; }
+  // reason of the failure if the file could not be mapped
+  const std::string &error() const { return failure; }
+  std::string_view contents() const {
+    return {static_cast<const char *>(data), length};
+  }
+
+private:
+  void *data = nullptr;
+  size_t length = 0;
+  bool opened = false;
+  std::string failure;
+};
+
+#endif // MAPPED_FILE_HPP
@@ -0,0 +1,360 @@
+#include "node_arena.hpp"
+#include "dedupe.hpp"
+#include "formula_printer.hpp"
+#include "logic_builder.hpp"
+#include "logic_node.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <functional>
+#include <unordered_map>
+
+// The hashes follow the same scheme as the stored hashes of Logic_Node, for
+// gates without constants or repeated children, which arena gates never have
+static size_t arena_variable_hash(int literal) {
+  return std::hash<int>()(literal) * 31;
+}
+
+static size_t arena_gate_hash(Node_Kind kind, const std::vector<NodeId> &children,
+                              const std::vector<size_t> &hashes) {
+  size_t hash_value = (kind == Node_Kind::AND_GATE) ? 17 : 23;
+  for (NodeId child : children) {
+    hash_value = hash_value * 31 + hashes[child];
+  }
+  return hash_value;
+}
+
+Node_Arena::Node_Arena() {
+  add_node(Node_Kind::CONSTANT, 0, 0, 0); // false_id
+  add_node(Node_Kind::CONSTANT, 1, 0, 1); // true_id
+}
+
+void Node_Arena::clear() {
+  kinds.clear();
+  data.clear();
+  child_counts.clear();
+  hashes.clear();
+  child_pool.clear();
+  unique_table.clear();
+  eval_stamps.clear();
+  eval_values.clear();
+  add_node(Node_Kind::CONSTANT, 0, 0, 0);
+  add_node(Node_Kind::CONSTANT, 1, 0, 1);
+}
+
+Node_Kind Node_Arena::kind(NodeId id) const {
+  return static_cast<Node_Kind>(kinds[id]);
+}
+
+bool Node_Arena::value(NodeId id) const {
+  assert(kind(id) == Node_Kind::CONSTANT);
+  return data[id];
+}
+
+int Node_Arena::literal(NodeId id) const {
+  assert(kind(id) == Node_Kind::VARIABLE);
+  return data[id];
+}
+
+std::span<const NodeId> Node_Arena::children(NodeId id) const {
+  if (kind(id) != Node_Kind::AND_GATE && kind(id) != Node_Kind::OR_GATE) {
+    return {};
+  }
+  return std::span<const NodeId>(child_pool.data() + data[id], child_counts[id]);
+}
+
+size_t Node_Arena::arity(NodeId id) const {
+  switch (kind(id)) {
+  case Node_Kind::CONSTANT:
+    return 0;
+  case Node_Kind::VARIABLE:
+    return 1;
+  case Node_Kind::AND_GATE:
+  case Node_Kind::OR_GATE:
+    break;
+  }
+  return child_counts[id];
+}
+
+NodeId Node_Arena::add_node(Node_Kind kind, int32_t value, uint32_t count,
+                            size_t hash) {
+  assert(kinds.size() < UINT32_MAX);
+  const NodeId id = kinds.size();
+  kinds.push_back(static_cast<uint8_t>(kind));
+  data.push_back(value);
+  child_counts.push_back(count);
+  hashes.push_back(hash);
+  if (kind != Node_Kind::CONSTANT) {
+    insert_unique(id);
+  }
+  return id;
+}
+
+void Node_Arena::insert_unique(NodeId id) {
+  // keep the load factor below one half
+  if (2 * (kinds.size() + 1) > unique_table.size()) {
+    grow_unique_table();
+  }
+  const size_t mask = unique_table.size() - 1;
+  size_t pos = hashes[id] & mask;
+  while (unique_table[pos]) {
+    pos = (pos + 1) & mask;
+  }
+  unique_table[pos] = id + 1;
+}
+
+void Node_Arena::grow_unique_table() {
+  std::vector<uint32_t> old = std::move(unique_table);
+  unique_table.assign(std::max<size_t>(64, 2 * old.size()), 0);
+  const size_t mask = unique_table.size() - 1;
+  for (uint32_t entry : old) {
+    if (!entry) continue;
+    size_t pos = hashes[entry - 1] & mask;
+    while (unique_table[pos]) {
+      pos = (pos + 1) & mask;
+    }
+    unique_table[pos] = entry;
+  }
+}
+
+NodeId Node_Arena::make_variable(int literal) {
+  const size_t hash = arena_variable_hash(literal);
+  if (!unique_table.empty()) {
+    const size_t mask = unique_table.size() - 1;
+    for (size_t pos = hash & mask; unique_table[pos]; pos = (pos + 1) & mask) {
+      const NodeId id = unique_table[pos] - 1;
+      if (hashes[id] == hash && kind(id) == Node_Kind::VARIABLE &&
+          data[id] == literal) {
+        return id;
+      }
+    }
+  }
+  return add_node(Node_Kind::VARIABLE, literal, 0, hash);
+}
+
+NodeId Node_Arena::make_conjunction(std::vector<NodeId> children) {
+  return make_gate(Node_Kind::AND_GATE, children);
+}
+
+NodeId Node_Arena::make_disjunction(std::vector<NodeId> children) {
+  return make_gate(Node_Kind::OR_GATE, children);
+}
+
+NodeId Node_Arena::make_gate(Node_Kind kind, std::vector<NodeId> &children) {
+  // AND: False absorbs, True is neutral. OR: the other way around.
+  const NodeId absorbing = kind == Node_Kind::AND_GATE ? false_id : true_id;
+  const NodeId neutral = kind == Node_Kind::AND_GATE ? true_id : false_id;
+
+  size_t kept = 0;
+  for (size_t i = 0; i < children.size(); ++i) {
+    const NodeId child = children[i];
+    if (child == absorbing) {
+      return absorbing;
+    }
+    if (child != neutral) {
+      children[kept++] = child;
+    }
+  }
+  children.resize(kept);
+  // Nodes are unique, so duplicates are equal ids. Drop them, keeping the
+  // first occurrence to preserve the order of the children.
+  keep_first_occurrences(children, [](NodeId id) { return id; });
+  if (children.empty()) {
+    return neutral;
+  }
+  if (children.size() == 1) {
+    return children[0];
+  }
+
+  const size_t hash = arena_gate_hash(kind, children, hashes);
+  if (!unique_table.empty()) {
+    const size_t mask = unique_table.size() - 1;
+    for (size_t pos = hash & mask; unique_table[pos]; pos = (pos + 1) & mask) {
+      const NodeId id = unique_table[pos] - 1;
+      if (hashes[id] == hash && this->kind(id) == kind &&
+          child_counts[id] == children.size() &&
+          std::equal(children.begin(), children.end(),
+                     child_pool.begin() + data[id])) {
+        return id;
+      }
+    }
+  }
+  const int32_t first = child_pool.size();
+  child_pool.insert(child_pool.end(), children.begin(), children.end());
+  return add_node(kind, first, children.size(), hash);
+}
+
+// Iterative DAG evaluation on 64-bit masks, each node at most once per call.
+// A gate is left as soon as its value is decided.
+template <typename Leaf>
+uint64_t Node_Arena::evaluate_dag(NodeId root, Leaf leaf) const {
+  if (eval_stamps.size() < size()) {
+    eval_stamps.resize(size(), 0);
+    eval_values.resize(size());
+  }
+  if (!++eval_epoch) {
+    std::fill(eval_stamps.begin(), eval_stamps.end(), 0);
+    eval_epoch = 1;
+  }
+  auto is_gate = [this](NodeId id) {
+    return kind(id) == Node_Kind::AND_GATE || kind(id) == Node_Kind::OR_GATE;
+  };
+  if (!is_gate(root)) {
+    return leaf(root);
+  }
+
+  std::vector<std::pair<NodeId, uint32_t>> stack;
+  eval_values[root] = kind(root) == Node_Kind::AND_GATE ? ~uint64_t(0) : 0;
+  stack.emplace_back(root, 0);
+  while (!stack.empty()) {
+    auto &[id, next] = stack.back();
+    const bool conjunction = kind(id) == Node_Kind::AND_GATE;
+    const uint64_t decided = conjunction ? 0 : ~uint64_t(0);
+    if (next == child_counts[id] || eval_values[id] == decided) {
+      eval_stamps[id] = eval_epoch;
+      stack.pop_back();
+      continue;
+    }
+    const NodeId child = child_pool[data[id] + next];
+    if (eval_stamps[child] != eval_epoch) {
+      if (!is_gate(child)) {
+        eval_values[child] = leaf(child);
+        eval_stamps[child] = eval_epoch;
+      } else {
+        // combined into `id` once it is done
+        eval_values[child] = kind(child) == Node_Kind::AND_GATE ? ~uint64_t(0) : 0;
+        stack.emplace_back(child, 0);
+        continue;
+      }
+    }
+    if (conjunction) {
+      eval_values[id] &= eval_values[child];
+    } else {
+      eval_values[id] |= eval_values[child];
+    }
+    ++next;
+  }
+  return eval_values[root];
+}
+
+bool Node_Arena::evaluate(NodeId id, const std::vector<bool> &model) const {
+  auto leaf = [this, &model](NodeId leaf_id) -> uint64_t {
+    if (kind(leaf_id) == Node_Kind::CONSTANT) {
+      return data[leaf_id] ? ~uint64_t(0) : 0;
+    }
+    const int literal = data[leaf_id];
+    const int index = std::abs(literal) - 1;
+    if (index < 0 || index >= static_cast<int>(model.size())) {
+      return 0;
+    }
+    return (literal > 0 ? model[index] : !model[index]) ? ~uint64_t(0) : 0;
+  };
+  return evaluate_dag(id, leaf) & 1;
+}
+
+uint64_t Node_Arena::evaluate_batch(NodeId id,
+                                    const std::vector<uint64_t> &models) const {
+  auto leaf = [this, &models](NodeId leaf_id) -> uint64_t {
+    if (kind(leaf_id) == Node_Kind::CONSTANT) {
+      return data[leaf_id] ? ~uint64_t(0) : 0;
+    }
+    const int literal = data[leaf_id];
+    const int index = std::abs(literal) - 1;
+    if (index < 0 || index >= static_cast<int>(models.size())) {
+      return 0;
+    }
+    return literal > 0 ? models[index] : ~models[index];
+  };
+  return evaluate_dag(id, leaf);
+}
+
+NodeId Node_Arena::import(const Formula &f) {
+  // post-order over the distinct nodes, keyed by Logic_Node id
+  std::unordered_map<uint64_t, NodeId> imported;
+  std::vector<std::pair<const Logic_Node *, size_t>> stack;
+  stack.emplace_back(&f, 0);
+  while (!stack.empty()) {
+    auto &[node, next] = stack.back();
+    const Gate *gate = as_gate(*node);
+    if (gate && next < gate->arity()) {
+      const Logic_Node *child = gate->getChildren()[next++].get();
+      if (!imported.count(child->getId())) {
+        stack.emplace_back(child, 0);
+      }
+      continue;
+    }
+    NodeId id;
+    if (const Constant *constant = as_constant(*node)) {
+      id = constant->getValue() ? true_id : false_id;
+    } else if (const Variable *variable = as_variable(*node)) {
+      id = make_variable(variable->getLiteral());
+    } else {
+      std::vector<NodeId> children;
+      children.reserve(gate->arity());
+      for (const auto &child : gate->getChildren()) {
+        children.push_back(imported.at(child->getId()));
+      }
+      id = make_gate(node->getKind(), children);
+    }
+    imported.emplace(node->getId(), id);
+    stack.pop_back();
+  }
+  return imported.at(f.getId());
+}
+
+std::shared_ptr<Formula> Node_Arena::export_formula(NodeId root,
+                                                    Logic_Builder &builder) const {
+  // Children have smaller ids than their parents, so building the reachable
+  // nodes by increasing id creates every node after its children.
+  std::vector<NodeId> reachable{root};
+  std::unordered_map<NodeId, std::shared_ptr<Formula>> exported;
+  exported.emplace(root, nullptr);
+  for (size_t i = 0; i < reachable.size(); ++i) {
+    for (NodeId child : children(reachable[i])) {
+      if (exported.emplace(child, nullptr).second) {
+        reachable.push_back(child);
+      }
+    }
+  }
+  std::sort(reachable.begin(), reachable.end());
+
+  std::vector<std::shared_ptr<Formula>> gate_children;
+  for (NodeId id : reachable) {
+    std::shared_ptr<Formula> node;
+    switch (kind(id)) {
+    case Node_Kind::CONSTANT:
+      node = data[id] ? builder.make_true() : builder.make_false();
+      break;
+    case Node_Kind::VARIABLE:
+      node = builder.make_variable(data[id]);
+      break;
+    case Node_Kind::AND_GATE:
+    case Node_Kind::OR_GATE:
+      gate_children.clear();
+      for (NodeId child : children(id)) {
+        gate_children.push_back(exported.at(child));
+      }
+      node = kind(id) == Node_Kind::AND_GATE
+                 ? builder.make_conjunction(gate_children)
+                 : builder.make_disjunction(gate_children);
+      break;
+    }
+    exported[id] = std::move(node);
+  }
+  return exported.at(root);
+}
+
+size_t Node_Arena::memory_usage() const {
+  return kinds.capacity() * sizeof(uint8_t) + data.capacity() * sizeof(int32_t) +
+         child_counts.capacity() * sizeof(uint32_t) +
+         hashes.capacity() * sizeof(size_t) +
+         child_pool.capacity() * sizeof(NodeId) +
+         unique_table.capacity() * sizeof(uint32_t);
+}
+
+// same text format as print_formula on Logic_Node, shared gates named once
+std::ostream &operator<<(std::ostream &stream, const Arena_Formula &f) {
+  print_formula(stream, f);
+  return stream;
+}
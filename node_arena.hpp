@@ -0,0 +1,127 @@
+#ifndef NODE_ARENA_HPP
+#define NODE_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <vector>
+
+class Logic_Node;
+class Logic_Builder;
+enum class Node_Kind;
+typedef Logic_Node Formula;
+
+typedef uint32_t NodeId;
+
+// Index-based node store
+//
+// Nodes live in parallel arrays owned by the arena (struct of arrays) and are
+// addressed by 32-bit NodeIds instead of shared_ptrs. Children of a gate are a
+// contiguous range of the child pool. Children are always created before their
+// parents, so every id is larger than the ids of its children.
+//
+// The arena is hash-consed: the make_* functions apply the simplification
+// rules of Logic_Builder (constants are absorbed or dropped, duplicates are
+// removed, singleton gates collapse) and look up a unique table, so every node
+// is simplified and equal formulas have equal ids.
+class Node_Arena {
+public:
+  Node_Arena();
+
+  NodeId make_true() const { return true_id; }
+  NodeId make_false() const { return false_id; }
+  NodeId make_variable(int literal);
+  NodeId make_conjunction(std::vector<NodeId> children);
+  NodeId make_disjunction(std::vector<NodeId> children);
+
+  Node_Kind kind(NodeId id) const;
+  bool value(NodeId id) const;  // for constants
+  int literal(NodeId id) const; // for variables
+  std::span<const NodeId> children(NodeId id) const;
+  size_t arity(NodeId id) const; // same convention as Logic_Node::arity
+  size_t hash(NodeId id) const { return hashes[id]; }
+
+  // Same semantics as Logic_Node::evaluation and evaluation_batch. Every node
+  // is evaluated at most once per call. The scratch state lives in the arena,
+  // hence concurrent evaluations are not allowed.
+  bool evaluate(NodeId id, const std::vector<bool> &model) const;
+  uint64_t evaluate_batch(NodeId id, const std::vector<uint64_t> &models) const;
+
+  // Conversions from and to shared_ptr formulas. Importing simplifies.
+  NodeId import(const Formula &f);
+  std::shared_ptr<Formula> export_formula(NodeId id, Logic_Builder &builder) const;
+
+  size_t size() const { return kinds.size(); }
+  // drops every node, previously returned ids become invalid
+  void clear();
+  // bytes used by the arrays (capacity, including the unique table)
+  size_t memory_usage() const;
+
+private:
+  static constexpr NodeId false_id = 0;
+  static constexpr NodeId true_id = 1;
+
+  // one entry per node
+  std::vector<uint8_t> kinds;
+  // literal of a variable, value of a constant, or start of the children
+  std::vector<int32_t> data;
+  std::vector<uint32_t> child_counts;
+  std::vector<size_t> hashes;
+  // children of all gates
+  std::vector<NodeId> child_pool;
+
+  // open addressing, stores id + 1 and 0 for empty slots
+  std::vector<uint32_t> unique_table;
+
+  mutable std::vector<uint32_t> eval_stamps;
+  mutable std::vector<uint64_t> eval_values;
+  mutable uint32_t eval_epoch = 0;
+
+  NodeId make_gate(Node_Kind kind, std::vector<NodeId> &children);
+  NodeId add_node(Node_Kind kind, int32_t data, uint32_t count, size_t hash);
+  void insert_unique(NodeId id);
+  void grow_unique_table();
+  template <typename Leaf> uint64_t evaluate_dag(NodeId root, Leaf leaf) const;
+};
+
+// Thin handle giving arena nodes the interface of Formula
+//
+// Handles are accepted by walk_formula, for_each_node and print_formula.
+// Logic_Builder::simplify and normalize take shared_ptr formulas only: arena
+// nodes are simplified when they are made, and export_formula converts them
+// for the other algorithms of the builder.
+class Arena_Formula {
+public:
+  Arena_Formula(const Node_Arena &arena, NodeId id) : arena(&arena), id(id) {}
+
+  NodeId getId() const { return id; }
+  Node_Kind getKind() const { return arena->kind(id); }
+  size_t arity() const { return arena->arity(id); }
+  size_t hash() const { return arena->hash(id); }
+  bool getValue() const { return arena->value(id); }   // for constants
+  int getLiteral() const { return arena->literal(id); } // for variables
+  bool evaluation(const std::vector<bool> &inputs) const {
+    return arena->evaluate(id, inputs);
+  }
+  uint64_t evaluation_batch(const std::vector<uint64_t> &inputs) const {
+    return arena->evaluate_batch(id, inputs);
+  }
+  Arena_Formula child(size_t i) const {
+    return Arena_Formula(*arena, arena->children(id)[i]);
+  }
+
+  // nodes are hash-consed, so structural equality is an id comparison
+  bool operator==(const Arena_Formula &other) const {
+    return arena == other.arena && id == other.id;
+  }
+
+  friend std::ostream &operator<<(std::ostream &stream, const Arena_Formula &f);
+
+private:
+  const Node_Arena *arena;
+  NodeId id;
+};
+
+#endif // NODE_ARENA_HPP
@@ -0,0 +1,382 @@
+#include "sat_solver.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+Sat_Solver::Lit Sat_Solver::lit_of(int literal) {
+  assert(literal != 0);
+  return 2 * (std::abs(literal) - 1) + (literal < 0);
+}
+
+void Sat_Solver::grow(uint32_t variables) {
+  while (assignment.size() < variables) {
+    const uint32_t v = assignment.size();
+    assignment.push_back(UNASSIGNED);
+    levels.push_back(0);
+    reasons.push_back(no_reason);
+    saved_phase.push_back(FALSE);
+    activity.push_back(0);
+    seen.push_back(0);
+    heap_index.push_back(UINT32_MAX);
+    watches.emplace_back();
+    watches.emplace_back();
+    heap_insert(v);
+  }
+}
+
+void Sat_Solver::add_clause(const std::vector<int> &clause) {
+  assert(level() == 0);
+  if (inconsistent)
+    return;
+  std::vector<Lit> lits;
+  for (int literal : clause) {
+    grow(std::abs(literal));
+    lits.push_back(lit_of(literal));
+  }
+  // drop duplicates and false literals, skip tautologies and satisfied clauses
+  std::sort(lits.begin(), lits.end());
+  lits.erase(std::unique(lits.begin(), lits.end()), lits.end());
+  size_t kept = 0;
+  for (size_t i = 0; i < lits.size(); ++i) {
+    if (i + 1 < lits.size() && lits[i + 1] == negate(lits[i]))
+      return;
+    if (value_of(lits[i]) == TRUE)
+      return;
+    if (value_of(lits[i]) == UNASSIGNED)
+      lits[kept++] = lits[i];
+  }
+  lits.resize(kept);
+
+  if (lits.empty()) {
+    inconsistent = true;
+  } else if (lits.size() == 1) {
+    assign(lits[0], no_reason);
+    inconsistent = propagate() != no_reason;
+  } else {
+    clauses.push_back({std::move(lits), false});
+    attach(clauses.size() - 1);
+  }
+}
+
+void Sat_Solver::attach(uint32_t clause) {
+  const std::vector<Lit> &lits = clauses[clause].lits;
+  watches[negate(lits[0])].push_back({clause, lits[1]});
+  watches[negate(lits[1])].push_back({clause, lits[0]});
+}
+
+void Sat_Solver::assign(Lit l, uint32_t reason) {
+  const uint32_t v = var_of(l);
+  assignment[v] = !(l & 1);
+  levels[v] = level();
+  reasons[v] = reason;
+  trail.push_back(l);
+}
+
+uint32_t Sat_Solver::propagate() {
+  while (propagated < trail.size()) {
+    // clauses watching the literal that just became false
+    const Lit false_lit = negate(trail[propagated++]);
+    ++propagation_count;
+    std::vector<Watch> &list = watches[trail[propagated - 1]];
+    size_t i = 0, j = 0;
+    while (i < list.size()) {
+      const Watch watch = list[i++];
+      if (value_of(watch.blocker) == TRUE) {
+        list[j++] = watch;
+        continue;
+      }
+      Clause &clause = clauses[watch.clause];
+      if (clause.deleted)
+        continue; // drop the watch
+      std::vector<Lit> &lits = clause.lits;
+      if (lits[0] == false_lit)
+        std::swap(lits[0], lits[1]);
+      if (value_of(lits[0]) == TRUE) {
+        list[j++] = {watch.clause, lits[0]};
+        continue;
+      }
+      // look for a new literal to watch
+      bool moved = false;
+      for (size_t k = 2; k < lits.size(); ++k) {
+        if (value_of(lits[k]) != FALSE) {
+          std::swap(lits[1], lits[k]);
+          watches[negate(lits[1])].push_back({watch.clause, lits[0]});
+          moved = true;
+          break;
+        }
+      }
+      if (moved)
+        continue;
+      list[j++] = watch;
+      if (value_of(lits[0]) == FALSE) {
+        // conflict: keep the remaining watches
+        while (i < list.size())
+          list[j++] = list[i++];
+        list.resize(j);
+        return watch.clause;
+      }
+      assign(lits[0], watch.clause);
+    }
+    list.resize(j);
+  }
+  return no_reason;
+}
+
+void Sat_Solver::bump_variable(uint32_t v) {
+  if ((activity[v] += activity_increment) > 1e100) {
+    for (double &a : activity)
+      a *= 1e-100;
+    activity_increment *= 1e-100;
+  }
+  if (heap_index[v] != UINT32_MAX)
+    heap_up(heap_index[v]);
+}
+
+void Sat_Solver::bump_clause(Clause &clause) {
+  if ((clause.activity += clause_increment) > 1e20) {
+    for (Clause &c : clauses)
+      c.activity *= 1e-20;
+    clause_increment *= 1e-20;
+  }
+}
+
+// A literal of the learnt clause is redundant if it is implied by the others:
+// all the other literals of its reason are in the clause or fixed at level 0.
+bool Sat_Solver::redundant(Lit l) const {
+  const uint32_t reason = reasons[var_of(l)];
+  if (reason == no_reason)
+    return false;
+  for (Lit other : clauses[reason].lits) {
+    const uint32_t v = var_of(other);
+    if (v != var_of(l) && !seen[v] && levels[v] > 0)
+      return false;
+  }
+  return true;
+}
+
+void Sat_Solver::analyze(uint32_t conflict, std::vector<Lit> &learnt,
+                         uint32_t &backjump) {
+  learnt.assign(1, 0); // room for the asserting literal
+  size_t open = 0;     // literals of the current level still to resolve
+  size_t index = trail.size();
+  Lit resolved = 0;
+  bool first = true;
+  do {
+    Clause &clause = clauses[conflict];
+    if (clause.learnt)
+      bump_clause(clause);
+    for (Lit l : clause.lits) {
+      if (!first && l == resolved)
+        continue;
+      const uint32_t v = var_of(l);
+      if (seen[v] || levels[v] == 0)
+        continue;
+      seen[v] = 1;
+      bump_variable(v);
+      if (levels[v] == level())
+        ++open;
+      else
+        learnt.push_back(l);
+    }
+    first = false;
+    // next literal of the current level on the trail
+    while (!seen[var_of(trail[--index])])
+      ;
+    resolved = trail[index];
+    conflict = reasons[var_of(resolved)];
+    seen[var_of(resolved)] = 0;
+  } while (--open > 0);
+  learnt[0] = negate(resolved);
+
+  // local minimization, the removed literals stay seen until the end
+  analyzed = learnt;
+  size_t kept = 1;
+  for (size_t i = 1; i < learnt.size(); ++i) {
+    if (!redundant(learnt[i]))
+      learnt[kept++] = learnt[i];
+  }
+  learnt.resize(kept);
+  for (Lit l : analyzed)
+    seen[var_of(l)] = 0;
+
+  // the literal of the highest remaining level is watched second
+  backjump = 0;
+  for (size_t i = 1; i < learnt.size(); ++i) {
+    if (levels[var_of(learnt[i])] > backjump) {
+      backjump = levels[var_of(learnt[i])];
+      std::swap(learnt[1], learnt[i]);
+    }
+  }
+}
+
+void Sat_Solver::backtrack(uint32_t target) {
+  if (level() <= target)
+    return;
+  for (size_t i = trail.size(); i-- > trail_limits[target];) {
+    const uint32_t v = var_of(trail[i]);
+    saved_phase[v] = assignment[v];
+    assignment[v] = UNASSIGNED;
+    reasons[v] = no_reason;
+    if (heap_index[v] == UINT32_MAX)
+      heap_insert(v);
+  }
+  trail.resize(trail_limits[target]);
+  trail_limits.resize(target);
+  propagated = trail.size();
+}
+
+void Sat_Solver::reduce_learnts() {
+  // Removes the less active half of the learnt clauses longer than two. Called
+  // at level 0, where no clause is the reason of an assignment that matters.
+  std::vector<uint32_t> candidates;
+  for (uint32_t c = 0; c < clauses.size(); ++c) {
+    if (clauses[c].learnt && !clauses[c].deleted && clauses[c].lits.size() > 2)
+      candidates.push_back(c);
+  }
+  std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+    return clauses[a].activity < clauses[b].activity;
+  });
+  for (size_t i = 0; i < candidates.size() / 2; ++i) {
+    Clause &clause = clauses[candidates[i]];
+    clause.deleted = true;
+    std::vector<Lit>().swap(clause.lits);
+    --learnt_count;
+  }
+  for (Lit l : trail)
+    reasons[var_of(l)] = no_reason;
+}
+
+// Luby sequence 1 1 2 1 1 2 4 1 1 2 ...
+static uint64_t luby(uint64_t i) {
+  uint64_t size = 1, power = 1;
+  while (size < i + 1) {
+    size = 2 * size + 1;
+    power *= 2;
+  }
+  while (size - 1 != i) {
+    size = (size - 1) / 2;
+    power /= 2;
+    if (i >= size)
+      i -= size;
+  }
+  return power;
+}
+
+Sat_Result Sat_Solver::solve(int64_t conflict_limit) {
+  if (inconsistent)
+    return Sat_Result::UNSATISFIABLE;
+  if (propagate() != no_reason) {
+    inconsistent = true;
+    return Sat_Result::UNSATISFIABLE;
+  }
+  uint64_t restarts = 0;
+  uint64_t next_restart = 100 * luby(restarts);
+  uint64_t conflicts_since_restart = 0;
+  size_t max_learnts = clauses.size() / 3 + 1000;
+  const uint64_t start = conflict_count;
+  std::vector<Lit> learnt;
+
+  for (;;) {
+    const uint32_t conflict = propagate();
+    if (conflict != no_reason) {
+      ++conflict_count;
+      ++conflicts_since_restart;
+      if (level() == 0) {
+        inconsistent = true;
+        return Sat_Result::UNSATISFIABLE;
+      }
+      uint32_t backjump;
+      analyze(conflict, learnt, backjump);
+      backtrack(backjump);
+      if (learnt.size() == 1) {
+        assign(learnt[0], no_reason);
+      } else {
+        clauses.push_back({learnt, true});
+        ++learnt_count;
+        bump_clause(clauses.back());
+        attach(clauses.size() - 1);
+        assign(learnt[0], clauses.size() - 1);
+      }
+      activity_increment /= 0.95;
+      clause_increment /= 0.999;
+      continue;
+    }
+
+    if (conflict_limit >= 0 &&
+        conflict_count - start >= static_cast<uint64_t>(conflict_limit)) {
+      backtrack(0);
+      return Sat_Result::UNKNOWN;
+    }
+    if (conflicts_since_restart >= next_restart) {
+      backtrack(0);
+      conflicts_since_restart = 0;
+      next_restart = 100 * luby(++restarts);
+      if (learnt_count > max_learnts) {
+        reduce_learnts();
+        max_learnts += max_learnts / 10;
+      }
+    }
+
+    // decide on the most active unassigned variable
+    uint32_t v = UINT32_MAX;
+    while (!heap.empty()) {
+      v = heap_pop();
+      if (assignment[v] == UNASSIGNED)
+        break;
+      v = UINT32_MAX;
+    }
+    if (v == UINT32_MAX)
+      return Sat_Result::SATISFIABLE;
+    ++decision_count;
+    trail_limits.push_back(trail.size());
+    assign(2 * v + (saved_phase[v] == FALSE), no_reason);
+  }
+}
+
+void Sat_Solver::heap_insert(uint32_t v) {
+  heap_index[v] = heap.size();
+  heap.push_back(v);
+  heap_up(heap.size() - 1);
+}
+
+uint32_t Sat_Solver::heap_pop() {
+  const uint32_t top = heap[0];
+  heap_index[top] = UINT32_MAX;
+  heap[0] = heap.back();
+  heap.pop_back();
+  if (!heap.empty()) {
+    heap_index[heap[0]] = 0;
+    heap_down(0);
+  }
+  return top;
+}
+
+void Sat_Solver::heap_up(size_t i) {
+  const uint32_t v = heap[i];
+  while (i > 0 && activity[heap[(i - 1) / 2]] < activity[v]) {
+    heap[i] = heap[(i - 1) / 2];
+    heap_index[heap[i]] = i;
+    i = (i - 1) / 2;
+  }
+  heap[i] = v;
+  heap_index[v] = i;
+}
+
+void Sat_Solver::heap_down(size_t i) {
+  const uint32_t v = heap[i];
+  for (;;) {
+    size_t child = 2 * i + 1;
+    if (child >= heap.size())
+      break;
+    if (child + 1 < heap.size() && activity[heap[child + 1]] > activity[heap[child]])
+      ++child;
+    if (activity[heap[child]] <= activity[v])
+      break;
+    heap[i] = heap[child];
+    heap_index[heap[i]] = i;
+    i = child;
+  }
+  heap[i] = v;
+  heap_index[v] = i;
+}
@@ -0,0 +1,104 @@
+#ifndef SAT_SOLVER_HPP
+#define SAT_SOLVER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class Sat_Result { SATISFIABLE, UNSATISFIABLE, UNKNOWN };
+
+// CDCL SAT solver
+//
+// Literals are DIMACS integers: variable v is v, its negation -v. Variables
+// are created on demand by add_clause. The solver uses two watched literals
+// with blocking literals, VSIDS decisions with phase saving, first-UIP
+// learning with local minimization, Luby restarts and a periodic reduction of
+// the learnt clauses by activity.
+class Sat_Solver {
+public:
+  Sat_Solver() = default;
+
+  // Clauses can only be added before solve is called
+  void add_clause(const std::vector<int> &clause);
+  int variables() const { return static_cast<int>(assignment.size()); }
+
+  // Returns UNKNOWN once `conflict_limit` conflicts are reached (a negative
+  // limit means none)
+  Sat_Result solve(int64_t conflict_limit = -1);
+  // value of variable v in the model found by solve
+  bool value(int v) const { return assignment[v - 1] == TRUE; }
+
+  uint64_t conflicts() const { return conflict_count; }
+  uint64_t decisions() const { return decision_count; }
+  uint64_t propagations() const { return propagation_count; }
+
+private:
+  // internal literals: 2 * (v - 1) for v, 2 * (v - 1) + 1 for -v
+  typedef uint32_t Lit;
+  static Lit lit_of(int literal);
+  static Lit negate(Lit l) { return l ^ 1; }
+  static uint32_t var_of(Lit l) { return l >> 1; }
+
+  static constexpr uint8_t FALSE = 0, TRUE = 1, UNASSIGNED = 2;
+  static constexpr uint32_t no_reason = UINT32_MAX;
+
+  struct Clause {
+    std::vector<Lit> lits; // the first two are watched
+    bool learnt;
+    bool deleted = false;
+    double activity = 0;
+  };
+  struct Watch {
+    uint32_t clause;
+    Lit blocker; // another literal of the clause, if true the clause is too
+  };
+
+  std::vector<Clause> clauses;
+  std::vector<std::vector<Watch>> watches; // indexed by literal
+  bool inconsistent = false;
+
+  // per variable
+  std::vector<uint8_t> assignment;
+  std::vector<uint32_t> levels;
+  std::vector<uint32_t> reasons;
+  std::vector<uint8_t> saved_phase;
+  std::vector<double> activity;
+  std::vector<uint8_t> seen;
+  std::vector<Lit> analyzed; // literals to unmark after analyze
+
+  std::vector<Lit> trail;
+  std::vector<size_t> trail_limits; // start of each decision level
+  size_t propagated = 0;
+
+  // VSIDS: binary max-heap of variables by activity
+  std::vector<uint32_t> heap;
+  std::vector<uint32_t> heap_index; // UINT32_MAX if not in the heap
+  double activity_increment = 1;
+  double clause_increment = 1;
+
+  uint64_t conflict_count = 0, decision_count = 0, propagation_count = 0;
+  size_t learnt_count = 0;
+
+  uint8_t value_of(Lit l) const {
+    const uint8_t v = assignment[var_of(l)];
+    return v == UNASSIGNED ? UNASSIGNED : static_cast<uint8_t>(v ^ (l & 1));
+  }
+  uint32_t level() const { return trail_limits.size(); }
+  void grow(uint32_t variables);
+  void attach(uint32_t clause);
+  void assign(Lit l, uint32_t reason);
+  uint32_t propagate(); // returns the conflicting clause or no_reason
+  void analyze(uint32_t conflict, std::vector<Lit> &learnt, uint32_t &backjump);
+  bool redundant(Lit l) const;
+  void backtrack(uint32_t target);
+  void bump_variable(uint32_t v);
+  void bump_clause(Clause &clause);
+  void reduce_learnts();
+
+  void heap_insert(uint32_t v);
+  uint32_t heap_pop();
+  void heap_up(size_t i);
+  void heap_down(size_t i);
+};
+
+#endif // SAT_SOLVER_HPP
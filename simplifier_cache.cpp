@@ -0,0 +1,174 @@
+#include "simplifier_cache.hpp"
+#include "logic_node.hpp"
+
+#include <bit>
+#include <cassert>
+#include <cstdint>
+
+Simplifier_Cache::Simplifier_Cache(size_t shards)
+    : shard_count(std::bit_ceil(shards ? shards : 1)),
+      shard_shift(64 - std::countr_zero(shard_count)),
+      shards(new Shard[shard_count]) {
+  for (size_t i = 0; i < shard_count; ++i)
+    this->shards[i].hand = this->shards[i].entries.end();
+}
+
+Simplifier_Cache::Shard &
+Simplifier_Cache::shard_of(const std::shared_ptr<Formula> &f) const {
+  // The low bits of the structural hash are poor for small formulas, take the
+  // high bits of a multiplicative mix instead.
+  const uint64_t mixed = static_cast<uint64_t>(f->hash()) * 0x9e3779b97f4a7c15ull;
+  return shards[shard_shift == 64 ? 0 : mixed >> shard_shift];
+}
+
+size_t Simplifier_Cache::entry_bytes(const Formula &f) {
+  // list node, hash map node and bucket, and the control block of the key
+  constexpr size_t bookkeeping = sizeof(Entry) + 2 * sizeof(void *) + sizeof(Key) +
+                                 sizeof(entry_list::iterator) + 3 * sizeof(void *) +
+                                 2 * sizeof(long);
+  switch (f.getKind()) {
+  case Node_Kind::CONSTANT:
+    return bookkeeping + sizeof(Constant);
+  case Node_Kind::VARIABLE:
+    return bookkeeping + sizeof(Variable);
+  case Node_Kind::AND_GATE:
+  case Node_Kind::OR_GATE:
+    return bookkeeping + sizeof(Gate) +
+           as_gate(f)->getChildren().capacity() * sizeof(std::shared_ptr<Formula>);
+  }
+  return bookkeeping;
+}
+
+void Simplifier_Cache::evict(Shard &shard, entry_list &evicted) {
+  if (policy == Eviction_Policy::NONE || budget == 0)
+    return;
+  const size_t shard_budget = budget / shard_count;
+  while (shard.bytes > shard_budget && !shard.entries.empty()) {
+    entry_list::iterator victim;
+    if (policy == Eviction_Policy::LRU) {
+      victim = std::prev(shard.entries.end());
+    } else {
+      // advance the hand, clearing reference bits, until an unreferenced entry
+      for (;;) {
+        if (shard.hand == shard.entries.end())
+          shard.hand = shard.entries.begin();
+        if (!shard.hand->referenced)
+          break;
+        shard.hand->referenced = false;
+        ++shard.hand;
+      }
+      victim = shard.hand++;
+    }
+    [[maybe_unused]] const size_t erased =
+        shard.map.erase(Key{victim->key.node, victim->key.hash, true});
+    assert(erased == 1);
+    shard.bytes -= victim->bytes;
+    ++shard.evictions;
+    evicted.splice(evicted.end(), shard.entries, victim);
+  }
+}
+
+std::shared_ptr<Formula> Simplifier_Cache::find(const std::shared_ptr<Formula> &f) {
+  Shard &shard = shard_of(f);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.map.find(Key{f, f->hash()});
+  if (it == shard.map.end()) {
+    ++shard.misses;
+    return nullptr;
+  }
+  ++shard.hits;
+  if (policy == Eviction_Policy::LRU)
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+  else
+    it->second->referenced = true;
+  return it->second->representative;
+}
+
+std::shared_ptr<Formula>
+Simplifier_Cache::insert(const std::shared_ptr<Formula> &f,
+                         std::shared_ptr<Formula> representative) {
+  entry_list evicted;
+  Shard &shard = shard_of(f);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  const Key key{f, f->hash()};
+  auto it = shard.map.find(key);
+  if (it != shard.map.end())
+    return it->second->representative;
+
+  const size_t bytes = entry_bytes(*f);
+  // new entries start unreferenced just behind the CLOCK hand, so they get a
+  // full sweep before they can be evicted
+  auto position = policy == Eviction_Policy::CLOCK ? shard.hand : shard.entries.begin();
+  auto entry = shard.entries.insert(position, Entry{key, representative, bytes, false});
+  shard.map.emplace(key, entry);
+  shard.bytes += bytes;
+  ++shard.insertions;
+  // the entry just inserted can be evicted if it alone exceeds the budget,
+  // the caller still gets its representative
+  evict(shard, evicted);
+  return representative;
+}
+
+void Simplifier_Cache::clear() {
+  for (size_t i = 0; i < shard_count; ++i) {
+    entry_list evicted;
+    std::lock_guard<std::mutex> lock(shards[i].mutex);
+    shards[i].map.clear();
+    evicted.splice(evicted.end(), shards[i].entries);
+    shards[i].hand = shards[i].entries.end();
+    shards[i].bytes = 0;
+  }
+}
+
+size_t Simplifier_Cache::size() const {
+  size_t total = 0;
+  for (size_t i = 0; i < shard_count; ++i) {
+    std::lock_guard<std::mutex> lock(shards[i].mutex);
+    total += shards[i].map.size();
+  }
+  return total;
+}
+
+void Simplifier_Cache::set_memory_budget(size_t bytes, Eviction_Policy policy) {
+  // lock every shard so that no insertion sees a half updated configuration
+  for (size_t i = 0; i < shard_count; ++i)
+    shards[i].mutex.lock();
+  this->policy = policy;
+  budget = bytes;
+  entry_list evicted;
+  for (size_t i = 0; i < shard_count; ++i) {
+    shards[i].hand = shards[i].entries.begin();
+    evict(shards[i], evicted);
+  }
+  for (size_t i = 0; i < shard_count; ++i)
+    shards[i].mutex.unlock();
+}
+
+Cache_Statistics Simplifier_Cache::statistics() const {
+  Cache_Statistics statistics;
+  for (size_t i = 0; i < shard_count; ++i) {
+    std::lock_guard<std::mutex> lock(shards[i].mutex);
+    statistics.hits += shards[i].hits;
+    statistics.misses += shards[i].misses;
+    statistics.insertions += shards[i].insertions;
+    statistics.evictions += shards[i].evictions;
+    statistics.entries += shards[i].map.size();
+    statistics.bytes += shards[i].bytes;
+  }
+  statistics.budget = budget;
+  return statistics;
+}
+
+void Simplifier_Cache::reset_statistics() {
+  for (size_t i = 0; i < shard_count; ++i) {
+    std::lock_guard<std::mutex> lock(shards[i].mutex);
+    shards[i].hits = shards[i].misses = 0;
+    shards[i].insertions = shards[i].evictions = 0;
+  }
+}
+
+std::shared_ptr<Simplifier_Cache> Simplifier_Cache::process_cache() {
+  static const std::shared_ptr<Simplifier_Cache> cache =
+      std::make_shared<Simplifier_Cache>();
+  return cache;
+}
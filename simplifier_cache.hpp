@@ -0,0 +1,120 @@
+#ifndef SIMPLIFIER_CACHE_HPP
+#define SIMPLIFIER_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "logic_builder.hpp"
+
+// How entries are chosen for eviction once the memory budget is exceeded
+enum class Eviction_Policy {
+  NONE,  // never evict, the budget is ignored
+  LRU,   // least recently used entry first
+  CLOCK, // second chance: recently used entries survive one sweep of the hand
+};
+
+struct Cache_Statistics {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t insertions = 0;
+  uint64_t evictions = 0;
+  size_t entries = 0;
+  // estimated bytes kept alive by the cache, see Simplifier_Cache::entry_bytes
+  size_t bytes = 0;
+  size_t budget = 0;
+};
+
+// Cache of simplified representatives, safe to use from many threads
+//
+// The map is split into shards selected by the stored hash of the formula,
+// each protected by its own mutex, so threads simplifying unrelated formulas
+// rarely contend. Insertion keeps the first representative: when two threads
+// simplify equal formulas concurrently, both end up with the same pointer.
+//
+// The cache can be bounded by a memory budget, split evenly over the shards.
+// Evicting an entry only loses sharing with formulas simplified later, the
+// results already handed out stay valid.
+class Simplifier_Cache {
+public:
+  // `shards` is rounded up to a power of two
+  explicit Simplifier_Cache(size_t shards = 64);
+
+  // cached representative of `f`, or nullptr
+  std::shared_ptr<Formula> find(const std::shared_ptr<Formula> &f);
+  // Stores `representative` for `f` unless `f` is cached already. Returns
+  // the representative that is in the cache afterwards.
+  std::shared_ptr<Formula> insert(const std::shared_ptr<Formula> &f,
+                                  std::shared_ptr<Formula> representative);
+  void clear();
+  size_t size() const;
+
+  // A budget of 0 means unbounded. Shrinking the budget evicts immediately.
+  void set_memory_budget(size_t bytes, Eviction_Policy policy);
+  Eviction_Policy eviction_policy() const { return policy; }
+  Cache_Statistics statistics() const;
+  void reset_statistics();
+
+  // Estimated memory attributed to one entry: the bookkeeping of the entry
+  // and the key node it keeps alive. Children are not counted since they are
+  // usually shared with other entries.
+  static size_t entry_bytes(const Formula &f);
+
+  // cache shared by every builder of the process
+  static std::shared_ptr<Simplifier_Cache> process_cache();
+
+private:
+  // Keys are hashed with the stored hash of the node at insertion: normalize
+  // may change a key in place later, and its entry must still be found when
+  // it is evicted. Eviction looks the entry up by identity.
+  struct Key {
+    std::shared_ptr<Formula> node;
+    size_t hash;
+    bool identity = false; // matches the same node only
+  };
+  struct Key_Hash {
+    size_t operator()(const Key &key) const { return key.hash; }
+  };
+  struct Key_Equal {
+    bool operator()(const Key &lhs, const Key &rhs) const {
+      if (lhs.identity || rhs.identity)
+        return lhs.node == rhs.node;
+      return lhs.hash == rhs.hash && Logic_Node_Equal()(lhs.node, rhs.node);
+    }
+  };
+  struct Entry {
+    Key key;
+    std::shared_ptr<Formula> representative;
+    size_t bytes;
+    bool referenced; // CLOCK reference bit
+  };
+  using entry_list = std::list<Entry>;
+  using map_type = std::unordered_map<Key, entry_list::iterator, Key_Hash, Key_Equal>;
+
+  // Entries are kept in a list: most recently used first for LRU, and as the
+  // ring swept by `hand` for CLOCK.
+  struct alignas(64) Shard {
+    mutable std::mutex mutex;
+    map_type map;
+    entry_list entries;
+    entry_list::iterator hand;
+    size_t bytes = 0;
+    uint64_t hits = 0, misses = 0, insertions = 0, evictions = 0;
+  };
+
+  size_t shard_count;
+  size_t shard_shift;
+  std::unique_ptr<Shard[]> shards;
+  Eviction_Policy policy = Eviction_Policy::NONE;
+  size_t budget = 0;
+
+  Shard &shard_of(const std::shared_ptr<Formula> &f) const;
+  // evicts from a locked shard until it fits its share of the budget, moving
+  // the evicted entries to `evicted` so they are destroyed after unlocking
+  void evict(Shard &shard, entry_list &evicted);
+};
+
+#endif // SIMPLIFIER_CACHE_HPP
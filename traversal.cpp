@@ -0,0 +1,19 @@
+#include "traversal.hpp"
+
+Node_Marks::Node_Marks() : owner(!in_use), nodes(owner ? shared : own) {
+  in_use = true;
+  nodes.clear();
+}
+
+Node_Marks::~Node_Marks() {
+  if (owner)
+    in_use = false;
+}
+
+bool Node_Marks::mark(const Logic_Node &n) {
+  return nodes.insert(n, true).second;
+}
+
+bool Node_Marks::marked(const Logic_Node &n) const {
+  return nodes.find(n) != nullptr;
+}
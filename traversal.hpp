@@ -0,0 +1,389 @@
+#ifndef TRAVERSAL_HPP
+#define TRAVERSAL_HPP
+
+#include "logic_node.hpp"
+#include "node_arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Depth-first traversal of formulas with an explicit stack
+//
+// Recursive algorithms on formulas overflow the call stack on deep formulas,
+// and generated inputs easily chain a few hundred thousand gates. They are
+// written instead as visitors driven by walk_formula, whose stack lives on the
+// heap and grows with the depth of the formula.
+//
+// A visitor provides three callbacks:
+//   bool enter(node)            `node` is reached. Returns true to walk its
+//                               children, false to treat it as finished.
+//   bool child_done(parent, i)  child i of `parent` is finished. Returns false
+//                               to skip the remaining children.
+//   void leave(node)            the children of an entered node are finished.
+// Gates are entered before their children and left after them, so `enter`
+// sees the nodes in pre-order and `leave` in post-order. Visitors pass results
+// from children to parents on a value stack of their own. Shared subformulas
+// are walked once per path.
+//
+// Walking from a node, the callbacks receive `const Logic_Node &`. Walking
+// from a shared_ptr, they receive the `const std::shared_ptr<Logic_Node> &`
+// held by the parent, for visitors that keep or cache the nodes they see.
+// Walking from an Arena_Formula, they receive Arena_Formula handles.
+// A gate must not change its children before it is left.
+
+namespace traversal_detail {
+
+inline const Logic_Node &node_of(const Logic_Node &n) { return n; }
+inline const Logic_Node &node_of(const std::shared_ptr<Logic_Node> &n) { return *n; }
+inline const Arena_Formula &node_of(const Arena_Formula &n) { return n; }
+
+inline const Logic_Node *handle_of(const std::shared_ptr<Logic_Node> &child,
+                                   const Logic_Node *) {
+  return child.get();
+}
+inline const std::shared_ptr<Logic_Node> *
+handle_of(const std::shared_ptr<Logic_Node> &child, const std::shared_ptr<Logic_Node> *) {
+  return &child;
+}
+
+template <typename Handle> struct Frame {
+  Handle handle;
+  const Gate *gate; // nullptr for leaves
+  size_t next;      // next child to walk
+};
+
+struct Arena_Frame {
+  Arena_Formula node;
+  size_t arity; // 0 for leaves
+  size_t next;
+};
+
+// The frames are kept between walks of a thread, so that walking a small
+// formula does not allocate. A walk started while another one of the same
+// kind is running (from a callback) gets a stack of its own.
+template <typename Frame> class Frame_Stack {
+public:
+  Frame_Stack() : owner(!in_use), frames(owner ? shared : own) { in_use = true; }
+  ~Frame_Stack() {
+    frames.clear();
+    if (owner)
+      in_use = false;
+  }
+  Frame_Stack(const Frame_Stack &) = delete;
+  Frame_Stack &operator=(const Frame_Stack &) = delete;
+
+private:
+  static inline thread_local std::vector<Frame> shared;
+  static inline thread_local bool in_use = false;
+  const bool owner;
+  std::vector<Frame> own;
+
+public:
+  std::vector<Frame> &frames;
+};
+
+template <typename Handle, typename Visitor>
+void walk(Handle root, Visitor &visitor) {
+  if (!visitor.enter(*root))
+    return;
+  Frame_Stack<Frame<Handle>> stack;
+  auto &frames = stack.frames;
+  frames.push_back({root, as_gate(node_of(*root)), 0});
+  while (!frames.empty()) {
+    Frame<Handle> &frame = frames.back();
+    if (frame.gate && frame.next < frame.gate->getChildren().size()) {
+      const auto &child = frame.gate->getChildren()[frame.next];
+      const Handle handle = handle_of(child, Handle());
+      if (visitor.enter(*handle)) {
+        frames.push_back({handle, as_gate(*child), 0});
+      } else if (!visitor.child_done(*frame.handle, frame.next++)) {
+        frame.next = SIZE_MAX;
+      }
+      continue;
+    }
+    const Handle done = frame.handle;
+    frames.pop_back();
+    visitor.leave(*done);
+    if (!frames.empty()) {
+      Frame<Handle> &parent = frames.back();
+      if (!visitor.child_done(*parent.handle, parent.next++))
+        parent.next = SIZE_MAX;
+    }
+  }
+}
+
+inline size_t gate_arity(const Arena_Formula &n) {
+  const Node_Kind kind = n.getKind();
+  return kind == Node_Kind::AND_GATE || kind == Node_Kind::OR_GATE ? n.arity() : 0;
+}
+
+// same walk on the handles of an arena
+template <typename Visitor> void walk_arena(const Arena_Formula &root, Visitor &visitor) {
+  if (!visitor.enter(root))
+    return;
+  Frame_Stack<Arena_Frame> stack;
+  auto &frames = stack.frames;
+  frames.push_back({root, gate_arity(root), 0});
+  while (!frames.empty()) {
+    Arena_Frame &frame = frames.back();
+    if (frame.next < frame.arity) {
+      const Arena_Formula child = frame.node.child(frame.next);
+      if (visitor.enter(child)) {
+        frames.push_back({child, gate_arity(child), 0});
+      } else if (!visitor.child_done(frame.node, frame.next++)) {
+        frame.next = SIZE_MAX;
+      }
+      continue;
+    }
+    const Arena_Formula done = frame.node;
+    frames.pop_back();
+    visitor.leave(done);
+    if (!frames.empty()) {
+      Arena_Frame &parent = frames.back();
+      if (!visitor.child_done(parent.node, parent.next++))
+        parent.next = SIZE_MAX;
+    }
+  }
+}
+
+} // namespace traversal_detail
+
+template <typename Visitor>
+void walk_formula(const Logic_Node &root, Visitor &visitor) {
+  traversal_detail::walk<const Logic_Node *>(&root, visitor);
+}
+
+template <typename Visitor>
+void walk_formula(const std::shared_ptr<Logic_Node> &root, Visitor &visitor) {
+  traversal_detail::walk<const std::shared_ptr<Logic_Node> *>(&root, visitor);
+}
+
+template <typename Visitor>
+void walk_formula(const Arena_Formula &root, Visitor &visitor) {
+  traversal_detail::walk_arena(root, visitor);
+}
+
+// Map from the nodes of a formula to small values, for scratch state that
+// must not grow with the number of nodes the process has created
+//
+// Open addressing on the node address. Every slot carries the epoch of its
+// entry, so clear() is an increment, and the slots are resized to the entries
+// of the last use when they outnumber them by far. The nodes must outlive
+// their entries: an address may be reused once its node is destroyed.
+template <typename Value> class Node_Table {
+public:
+  // value of `n`, nullptr if it has none
+  const Value *find(const Logic_Node &n) const {
+    if (slots.empty())
+      return nullptr;
+    for (size_t i = slot_of(&n);; i = (i + 1) & mask()) {
+      const Slot &slot = slots[i];
+      if (slot.epoch != epoch)
+        return nullptr;
+      if (slot.node == &n)
+        return &slot.value;
+    }
+  }
+  Value *find(const Logic_Node &n) {
+    return const_cast<Value *>(static_cast<const Node_Table &>(*this).find(n));
+  }
+  // Adds `n` with `value` unless it has one already. Returns its value and
+  // whether it was added.
+  std::pair<Value *, bool> insert(const Logic_Node &n, Value value) {
+    if (2 * (count + 1) > slots.size())
+      resize(std::max<size_t>(16, 2 * slots.size()));
+    for (size_t i = slot_of(&n);; i = (i + 1) & mask()) {
+      Slot &slot = slots[i];
+      if (slot.epoch != epoch) {
+        slot = {&n, epoch, value};
+        ++count;
+        return {&slot.value, true};
+      }
+      if (slot.node == &n)
+        return {&slot.value, false};
+    }
+  }
+  size_t size() const { return count; }
+  void clear() {
+    if (slots.size() > 64 && 8 * count < slots.size()) {
+      size_t capacity = 16;
+      while (capacity < 2 * count)
+        capacity *= 2;
+      slots.assign(capacity, Slot());
+      epoch = 1;
+    } else if (++epoch == 0) {
+      // on wrap-around old stamps could alias the new epoch
+      std::fill(slots.begin(), slots.end(), Slot());
+      epoch = 1;
+    }
+    count = 0;
+  }
+
+private:
+  struct Slot {
+    const Logic_Node *node = nullptr;
+    uint32_t epoch = 0; // never a live epoch
+    Value value{};
+  };
+  std::vector<Slot> slots;
+  uint32_t epoch = 1;
+  size_t count = 0;
+
+  size_t mask() const { return slots.size() - 1; }
+  size_t slot_of(const Logic_Node *n) const {
+    const uint64_t h = reinterpret_cast<uintptr_t>(n) * 0x9E3779B97F4A7C15ull;
+    return (h ^ (h >> 32)) & mask();
+  }
+  void resize(size_t capacity) {
+    std::vector<Slot> old(capacity);
+    old.swap(slots);
+    const uint32_t live = epoch;
+    epoch = 1;
+    count = 0;
+    for (const Slot &slot : old)
+      if (slot.epoch == live)
+        insert(*slot.node, slot.value);
+  }
+};
+
+// Map from the nodes of a formula to small values, indexed by node id
+//
+// A node is created after its children, so the ids of a formula mostly lie
+// below the id of its root. clear(top) starts a map for the formula rooted at
+// `top`, and a node with id i takes slot top - i of an epoch-stamped vector,
+// which is grown on demand. Past a fixed window the slots only grow to a few
+// times the entries, so that the ids the process created in between do not
+// decide the memory: the nodes beyond, and those newer than the root
+// (children set in place), go to a Node_Table instead.
+template <typename Value> class Node_Id_Table {
+public:
+  // value of `n`, nullptr if it has none
+  const Value *find(const Logic_Node &n) const {
+    const size_t i = top - n.getId();
+    if (i < slots.size())
+      return slots[i].epoch == epoch ? &slots[i].value : nullptr;
+    return far.find(n);
+  }
+  // Adds `n` with `value` unless it has one already. Returns its value and
+  // whether it was added.
+  std::pair<Value *, bool> insert(const Logic_Node &n, Value value) {
+    const size_t i = top - n.getId();
+    if (i >= slots.size() && i <= top && i < std::max(4 * count, window))
+      slots.resize(std::max(i + 1, 2 * slots.size()));
+    if (i >= slots.size())
+      return far.insert(n, value);
+    Slot &slot = slots[i];
+    if (slot.epoch == epoch)
+      return {&slot.value, false};
+    slot = {epoch, value};
+    ++count;
+    return {&slot.value, true};
+  }
+  void clear(uint64_t new_top) {
+    if (slots.size() > window && 8 * count < slots.size()) {
+      slots.assign(window, Slot());
+      epoch = 1;
+    } else if (++epoch == 0) {
+      // on wrap-around old stamps could alias the new epoch
+      std::fill(slots.begin(), slots.end(), Slot());
+      epoch = 1;
+    }
+    top = new_top;
+    count = 0;
+    far.clear();
+  }
+
+private:
+  static constexpr size_t window = size_t(1) << 16;
+  struct Slot {
+    uint32_t epoch = 0; // never a live epoch
+    Value value{};
+  };
+  std::vector<Slot> slots;
+  uint32_t epoch = 1;
+  uint64_t top = 0;
+  size_t count = 0;
+  Node_Table<Value> far;
+};
+
+// Set of nodes, for walks that visit every distinct node once
+//
+// A Node_Table, so the memory is proportional to the nodes marked and
+// starting a new set is a clear() instead of an allocation. Sets of a thread
+// share one table; a set created while another one is alive (from a
+// callback) gets its own.
+class Node_Marks {
+public:
+  Node_Marks();
+  ~Node_Marks();
+  Node_Marks(const Node_Marks &) = delete;
+  Node_Marks &operator=(const Node_Marks &) = delete;
+
+  // Adds `n`, returns false if it was marked already
+  bool mark(const Logic_Node &n);
+  bool marked(const Logic_Node &n) const;
+
+private:
+  static inline thread_local Node_Table<bool> shared;
+  static inline thread_local bool in_use = false;
+  const bool owner;
+  Node_Table<bool> own;
+  Node_Table<bool> &nodes;
+};
+
+// Set of the nodes of an arena, by id
+class Arena_Marks {
+public:
+  bool mark(const Arena_Formula &n) { return ids.insert(n.getId()).second; }
+  bool marked(const Arena_Formula &n) const { return ids.count(n.getId()); }
+
+private:
+  std::unordered_set<NodeId> ids;
+};
+
+enum class Visit_Order { PRE_ORDER, POST_ORDER };
+
+// Calls `callback` once for every distinct node reachable from `root`, shared
+// subformulas included only once. In pre-order a node comes before its
+// children, in post-order after them. Nothing is materialized, the memory
+// used is proportional to the depth and the number of distinct nodes.
+namespace traversal_detail {
+
+template <typename Callback, typename Marks> struct Distinct_Visitor {
+  Visit_Order order;
+  Callback &callback;
+  Marks marks;
+
+  template <typename Node> bool enter(const Node &n) {
+    if (!marks.mark(node_of(n)))
+      return false;
+    if (order == Visit_Order::PRE_ORDER)
+      callback(n);
+    return true;
+  }
+  template <typename Node> bool child_done(const Node &, size_t) { return true; }
+  template <typename Node> void leave(const Node &n) {
+    if (order == Visit_Order::POST_ORDER)
+      callback(n);
+  }
+};
+
+} // namespace traversal_detail
+
+template <typename Root, typename Callback>
+void for_each_node(const Root &root, Visit_Order order, Callback &&callback) {
+  traversal_detail::Distinct_Visitor<Callback, Node_Marks> visitor{order, callback, {}};
+  walk_formula(root, visitor);
+}
+
+template <typename Callback>
+void for_each_node(const Arena_Formula &root, Visit_Order order, Callback &&callback) {
+  traversal_detail::Distinct_Visitor<Callback, Arena_Marks> visitor{order, callback, {}};
+  walk_formula(root, visitor);
+}
+
+#endif // TRAVERSAL_HPP
@@ -0,0 +1,112 @@
+#include "tseitin.hpp"
+#include "logic_node.hpp"
+#include "traversal.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+Tseitin_Encoder::Tseitin_Encoder(int input_variables, Clause_Sink sink,
+                                 bool plaisted_greenbaum)
+    : sink(std::move(sink)), input_variables(input_variables),
+      plaisted_greenbaum(plaisted_greenbaum), next_variable(input_variables + 1) {}
+
+int Tseitin_Encoder::encode(const Formula &f, Polarity polarity) {
+  if (!plaisted_greenbaum)
+    polarity = Polarity::BOTH;
+  const uint8_t requested = static_cast<uint8_t>(polarity);
+  auto literal_of = [this](const Formula &n) -> int {
+    switch (n.getKind()) {
+    case Node_Kind::CONSTANT:
+      return static_cast<const Constant &>(n).getValue() ? true_variable : -true_variable;
+    case Node_Kind::VARIABLE:
+      return static_cast<const Variable &>(n).getLiteral();
+    default:
+      return gates.at(n.getId()).literal;
+    }
+  };
+
+  for_each_node(f, Visit_Order::POST_ORDER, [&](const Formula &n) {
+    switch (n.getKind()) {
+    case Node_Kind::CONSTANT:
+      if (!true_variable) {
+        true_variable = next_variable++;
+        clause.assign(1, true_variable);
+        emit();
+      }
+      return;
+    case Node_Kind::VARIABLE:
+      assert(std::abs(static_cast<const Variable &>(n).getLiteral()) <= input_variables);
+      return;
+    case Node_Kind::AND_GATE:
+    case Node_Kind::OR_GATE:
+      break;
+    }
+    Gate_Encoding &encoding = gates[n.getId()];
+    const uint8_t missing = requested & ~encoding.polarities;
+    if (!missing)
+      return; // encoded by an earlier call
+    if (!encoding.literal)
+      encoding.literal = next_variable++;
+    encoding.polarities |= missing;
+
+    // AND: g -> c for every child c, and all children -> g. OR is the dual,
+    // with every literal negated: the first half is its negative polarity.
+    const int sign = n.getKind() == Node_Kind::AND_GATE ? 1 : -1;
+    const uint8_t first_half = static_cast<uint8_t>(
+        sign > 0 ? Polarity::POSITIVE : Polarity::NEGATIVE);
+    const int g = encoding.literal;
+    const auto &children = static_cast<const Gate &>(n).getChildren();
+    if (missing & first_half) {
+      for (const auto &child : children) {
+        clause = {-sign * g, sign * literal_of(*child)};
+        emit();
+      }
+    }
+    if (missing & ~first_half) {
+      clause.assign(1, sign * g);
+      for (const auto &child : children)
+        clause.push_back(-sign * literal_of(*child));
+      emit();
+    }
+  });
+  return literal_of(f);
+}
+
+int max_variable(const Formula &f) {
+  int result = 0;
+  for_each_node(f, Visit_Order::PRE_ORDER, [&result](const Formula &n) {
+    if (const Variable *variable = as_variable(n))
+      result = std::max(result, std::abs(variable->getLiteral()));
+  });
+  return result;
+}
+
+Equivalence_Check sat_equivalence(const Formula &f, const Formula &g,
+                                  int64_t conflict_limit) {
+  const int inputs = std::max(max_variable(f), max_variable(g));
+  Sat_Solver solver;
+  Tseitin_Encoder encoder(inputs, [&solver](const std::vector<int> &clause) {
+    solver.add_clause(clause);
+  });
+  const int a = encoder.encode(f);
+  const int b = encoder.encode(g);
+  if (a == b)
+    return {Equivalence::EQUIVALENT, {}}; // same node or same literal
+
+  // the literals differ: a xor b
+  solver.add_clause({a, b});
+  solver.add_clause({-a, -b});
+  switch (solver.solve(conflict_limit)) {
+  case Sat_Result::UNSATISFIABLE:
+    return {Equivalence::EQUIVALENT, {}};
+  case Sat_Result::UNKNOWN:
+    return {Equivalence::UNKNOWN, {}};
+  case Sat_Result::SATISFIABLE:
+    break;
+  }
+  std::vector<bool> model(inputs);
+  for (int v = 1; v <= std::min(inputs, solver.variables()); ++v)
+    model[v - 1] = solver.value(v);
+  return {Equivalence::DIFFERENT, std::move(model)};
+}
@@ -0,0 +1,85 @@
+#ifndef TSEITIN_HPP
+#define TSEITIN_HPP
+
+#include "sat_solver.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+class Logic_Node;
+typedef Logic_Node Formula;
+
+// Polarities in which a literal is needed: POSITIVE if only `literal ->
+// formula` may be assumed, NEGATIVE for `formula -> literal`
+enum class Polarity : uint8_t { POSITIVE = 1, NEGATIVE = 2, BOTH = 3 };
+
+// Tseitin encoding of formulas into clauses
+//
+// Every distinct gate gets one variable, defined by clauses equivalent to
+// `variable <-> gate`. Shared subformulas are encoded once, also across the
+// calls to encode. The variables of the formulas keep their index, the gate
+// variables are numbered after `input_variables`. Constants are encoded with
+// one variable forced to true.
+//
+// With the Plaisted-Greenbaum option, only the implications in the requested
+// polarity are emitted. Gates have no negation, so the children of a gate
+// are needed in the polarity of the gate. A formula encoded POSITIVE and
+// asserted is equisatisfiable with its full encoding, with about half the
+// clauses. The missing half of a gate is emitted if a later call needs it.
+class Tseitin_Encoder {
+public:
+  typedef std::function<void(const std::vector<int> &)> Clause_Sink;
+
+  Tseitin_Encoder(int input_variables, Clause_Sink sink,
+                  bool plaisted_greenbaum = false);
+
+  // Returns a literal equivalent to `f` in `polarity` under the clauses
+  // emitted so far. Without Plaisted-Greenbaum, the polarity is always BOTH.
+  int encode(const Formula &f, Polarity polarity = Polarity::BOTH);
+  // highest variable used
+  int variables() const { return next_variable - 1; }
+  uint64_t clauses() const { return emitted_clauses; }
+
+private:
+  Clause_Sink sink;
+  const int input_variables;
+  const bool plaisted_greenbaum;
+  int next_variable;
+  int true_variable = 0;
+  uint64_t emitted_clauses = 0;
+  // Variable of each gate encoded so far and the polarities emitted for it.
+  // Keyed by node id, which unlike the address is never reused.
+  struct Gate_Encoding {
+    int literal = 0;
+    uint8_t polarities = 0;
+  };
+  std::unordered_map<uint64_t, Gate_Encoding> gates;
+  std::vector<int> clause;
+
+  void emit() {
+    sink(clause);
+    ++emitted_clauses;
+  }
+};
+
+// highest variable index occurring in `f`, 0 if there is none
+int max_variable(const Formula &f);
+
+enum class Equivalence { EQUIVALENT, DIFFERENT, UNKNOWN };
+
+struct Equivalence_Check {
+  Equivalence verdict;
+  // For DIFFERENT, a model on which the formulas differ, in the layout of
+  // Logic_Builder::evaluate: entry i is the value of variable i + 1
+  std::vector<bool> counterexample;
+};
+
+// Equivalence by SAT on the miter of the formulas: they are equivalent iff
+// there is no model on which their Tseitin literals differ. Gives up with
+// UNKNOWN after `conflict_limit` conflicts if it is not negative.
+Equivalence_Check sat_equivalence(const Formula &f, const Formula &g,
+                                  int64_t conflict_limit = -1);
+
+#endif // TSEITIN_HPP
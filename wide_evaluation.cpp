@@ -0,0 +1,291 @@
+#include "wide_evaluation.hpp"
+#include "logic_node.hpp"
+#include "traversal.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define WIDE_EVALUATION_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Lane operations on blocks of `words` words. The evaluator below is generic in
+// these, so every kernel shares the same traversal.
+template <size_t N> struct Scalar_Lanes {
+  static constexpr size_t words = N;
+  static void fill(uint64_t *dst, bool value) {
+    for (size_t i = 0; i < N; ++i)
+      dst[i] = value ? ~uint64_t(0) : 0;
+  }
+  static void load(uint64_t *dst, const uint64_t *src, bool negate) {
+    for (size_t i = 0; i < N; ++i)
+      dst[i] = negate ? ~src[i] : src[i];
+  }
+  static void and_into(uint64_t *dst, const uint64_t *src) {
+    for (size_t i = 0; i < N; ++i)
+      dst[i] &= src[i];
+  }
+  static void or_into(uint64_t *dst, const uint64_t *src) {
+    for (size_t i = 0; i < N; ++i)
+      dst[i] |= src[i];
+  }
+  static bool all_zero(const uint64_t *block) {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < N; ++i)
+      acc |= block[i];
+    return !acc;
+  }
+  static bool all_ones(const uint64_t *block) {
+    uint64_t acc = ~uint64_t(0);
+    for (size_t i = 0; i < N; ++i)
+      acc &= block[i];
+    return !~acc;
+  }
+};
+
+#ifdef WIDE_EVALUATION_X86
+struct Avx2_Lanes {
+  static constexpr size_t words = 4;
+  __attribute__((target("avx2"))) static __m256i get(const uint64_t *src) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+  }
+  __attribute__((target("avx2"))) static void put(uint64_t *dst, __m256i v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), v);
+  }
+  __attribute__((target("avx2"))) static void fill(uint64_t *dst, bool value) {
+    put(dst, _mm256_set1_epi64x(value ? -1 : 0));
+  }
+  __attribute__((target("avx2"))) static void load(uint64_t *dst,
+                                                   const uint64_t *src,
+                                                   bool negate) {
+    const __m256i mask = _mm256_set1_epi64x(negate ? -1 : 0);
+    put(dst, _mm256_xor_si256(get(src), mask));
+  }
+  __attribute__((target("avx2"))) static void and_into(uint64_t *dst,
+                                                       const uint64_t *src) {
+    put(dst, _mm256_and_si256(get(dst), get(src)));
+  }
+  __attribute__((target("avx2"))) static void or_into(uint64_t *dst,
+                                                      const uint64_t *src) {
+    put(dst, _mm256_or_si256(get(dst), get(src)));
+  }
+  __attribute__((target("avx2"))) static bool all_zero(const uint64_t *block) {
+    const __m256i v = get(block);
+    return _mm256_testz_si256(v, v);
+  }
+  __attribute__((target("avx2"))) static bool all_ones(const uint64_t *block) {
+    return _mm256_testc_si256(get(block), _mm256_set1_epi64x(-1));
+  }
+};
+
+struct Avx512_Lanes {
+  static constexpr size_t words = 8;
+  __attribute__((target("avx512f"))) static __m512i get(const uint64_t *src) {
+    return _mm512_loadu_si512(src);
+  }
+  __attribute__((target("avx512f"))) static void put(uint64_t *dst, __m512i v) {
+    _mm512_storeu_si512(dst, v);
+  }
+  __attribute__((target("avx512f"))) static void fill(uint64_t *dst, bool value) {
+    put(dst, _mm512_set1_epi64(value ? -1 : 0));
+  }
+  __attribute__((target("avx512f"))) static void load(uint64_t *dst,
+                                                      const uint64_t *src,
+                                                      bool negate) {
+    const __m512i mask = _mm512_set1_epi64(negate ? -1 : 0);
+    put(dst, _mm512_xor_si512(get(src), mask));
+  }
+  __attribute__((target("avx512f"))) static void and_into(uint64_t *dst,
+                                                          const uint64_t *src) {
+    put(dst, _mm512_and_si512(get(dst), get(src)));
+  }
+  __attribute__((target("avx512f"))) static void or_into(uint64_t *dst,
+                                                         const uint64_t *src) {
+    put(dst, _mm512_or_si512(get(dst), get(src)));
+  }
+  __attribute__((target("avx512f"))) static bool all_zero(const uint64_t *block) {
+    const __m512i v = get(block);
+    return !_mm512_test_epi64_mask(v, v);
+  }
+  __attribute__((target("avx512f"))) static bool all_ones(const uint64_t *block) {
+    return !_mm512_cmpneq_epi64_mask(get(block), _mm512_set1_epi64(-1));
+  }
+};
+#endif
+
+// Largest block of any kernel, in words
+constexpr size_t max_block_words = 8;
+
+struct Wide_Inputs {
+  const uint64_t *data;
+  size_t variables;
+  size_t words;
+};
+
+// Evaluates the block of models starting at word `offset`, keeping one block
+// per level of the walk on `blocks`
+template <class Lanes> struct Block_Visitor {
+  const Wide_Inputs &inputs;
+  size_t offset = 0;
+  std::vector<uint64_t> blocks;
+
+  uint64_t *push() {
+    blocks.resize(blocks.size() + Lanes::words);
+    return blocks.data() + blocks.size() - Lanes::words;
+  }
+  uint64_t *top() { return blocks.data() + blocks.size() - Lanes::words; }
+
+  bool enter(const Logic_Node &n) {
+    uint64_t *out = push();
+    switch (n.getKind()) {
+    case Node_Kind::CONSTANT:
+      Lanes::fill(out, static_cast<const Constant &>(n).getValue());
+      return false;
+    case Node_Kind::VARIABLE: {
+      const int literal = static_cast<const Variable &>(n).getLiteral();
+      const size_t index = std::abs(literal) - 1;
+      // out-of-range literals are false, as in Variable::evaluation
+      if (!literal || index >= inputs.variables)
+        Lanes::fill(out, false);
+      else
+        Lanes::load(out, inputs.data + index * inputs.words + offset, literal < 0);
+      return false;
+    }
+    case Node_Kind::AND_GATE:
+    case Node_Kind::OR_GATE:
+      break;
+    }
+    Lanes::fill(out, n.getKind() == Node_Kind::AND_GATE);
+    return true;
+  }
+  bool child_done(const Logic_Node &parent, size_t) {
+    alignas(64) uint64_t child_block[max_block_words];
+    std::copy(top(), top() + Lanes::words, child_block);
+    blocks.resize(blocks.size() - Lanes::words);
+    uint64_t *out = top();
+    if (parent.getKind() == Node_Kind::AND_GATE) {
+      Lanes::and_into(out, child_block);
+      return !Lanes::all_zero(out);
+    }
+    Lanes::or_into(out, child_block);
+    return !Lanes::all_ones(out);
+  }
+  void leave(const Logic_Node &) {}
+};
+
+// Evaluates as many full blocks as possible from `offset` on and returns the
+// offset of the first word that is left over.
+template <class Lanes>
+size_t evaluate_blocks(const Logic_Node &f, const Wide_Inputs &inputs,
+                       size_t offset, std::vector<uint64_t> &result) {
+  static_assert(Lanes::words <= max_block_words);
+  Block_Visitor<Lanes> visitor{inputs, offset, {}};
+  for (; offset + Lanes::words <= inputs.words; offset += Lanes::words) {
+    visitor.offset = offset;
+    visitor.blocks.clear();
+    walk_formula(f, visitor);
+    std::copy(visitor.blocks.begin(), visitor.blocks.end(), result.data() + offset);
+  }
+  return offset;
+}
+
+#ifdef WIDE_EVALUATION_X86
+// A function compiled for an instruction set cannot be inlined into a generic
+// caller, so each kernel has an entry point compiled for its instruction set
+// into which the whole walk is flattened, lane operations included.
+__attribute__((target("avx2"), flatten)) size_t
+evaluate_blocks_avx2(const Logic_Node &f, const Wide_Inputs &inputs, size_t offset,
+                     std::vector<uint64_t> &result) {
+  return evaluate_blocks<Avx2_Lanes>(f, inputs, offset, result);
+}
+
+__attribute__((target("avx512f"), flatten)) size_t
+evaluate_blocks_avx512(const Logic_Node &f, const Wide_Inputs &inputs, size_t offset,
+                       std::vector<uint64_t> &result) {
+  return evaluate_blocks<Avx512_Lanes>(f, inputs, offset, result);
+}
+#endif
+
+Wide_Kernel &selected_kernel() {
+  static Wide_Kernel kernel = detect_wide_kernel();
+  return kernel;
+}
+
+} // namespace
+
+Wide_Kernel detect_wide_kernel() {
+  if (wide_kernel_supported(Wide_Kernel::AVX512))
+    return Wide_Kernel::AVX512;
+  if (wide_kernel_supported(Wide_Kernel::AVX2))
+    return Wide_Kernel::AVX2;
+  return Wide_Kernel::SCALAR;
+}
+
+bool wide_kernel_supported(Wide_Kernel kernel) {
+  switch (kernel) {
+  case Wide_Kernel::SCALAR:
+    return true;
+#ifdef WIDE_EVALUATION_X86
+  case Wide_Kernel::AVX2:
+    return __builtin_cpu_supports("avx2");
+  case Wide_Kernel::AVX512:
+    return __builtin_cpu_supports("avx512f");
+#else
+  case Wide_Kernel::AVX2:
+  case Wide_Kernel::AVX512:
+    return false;
+#endif
+  }
+  return false;
+}
+
+const char *wide_kernel_name(Wide_Kernel kernel) {
+  switch (kernel) {
+  case Wide_Kernel::SCALAR:
+    return "scalar";
+  case Wide_Kernel::AVX2:
+    return "avx2";
+  case Wide_Kernel::AVX512:
+    return "avx512";
+  }
+  return "unknown";
+}
+
+Wide_Kernel wide_kernel() { return selected_kernel(); }
+
+void set_wide_kernel(Wide_Kernel kernel) {
+  assert(wide_kernel_supported(kernel));
+  selected_kernel() = kernel;
+}
+
+std::vector<uint64_t> evaluate_wide(const Logic_Node &f,
+                                    const std::vector<uint64_t> &inputs,
+                                    size_t words) {
+  std::vector<uint64_t> result(words);
+  if (!words)
+    return result;
+  assert(inputs.size() % words == 0);
+  const Wide_Inputs wide_inputs{inputs.data(), inputs.size() / words, words};
+
+  size_t offset = 0;
+  switch (wide_kernel()) {
+#ifdef WIDE_EVALUATION_X86
+  case Wide_Kernel::AVX512:
+    offset = evaluate_blocks_avx512(f, wide_inputs, offset, result);
+    break;
+  case Wide_Kernel::AVX2:
+    offset = evaluate_blocks_avx2(f, wide_inputs, offset, result);
+    break;
+#endif
+  default:
+    offset = evaluate_blocks<Scalar_Lanes<8>>(f, wide_inputs, offset, result);
+    break;
+  }
+  // the remaining words do not fill a vector register
+  evaluate_blocks<Scalar_Lanes<1>>(f, wide_inputs, offset, result);
+  return result;
+}
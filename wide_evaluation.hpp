@@ -0,0 +1,35 @@
+#ifndef WIDE_EVALUATION_HPP
+#define WIDE_EVALUATION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Logic_Node;
+
+// Wide-lane evaluation of AND/OR formulas
+//
+// The models are bit-packed and transposed like for
+// Logic_Node::evaluation_batch, but each variable spans `words` consecutive
+// words: `inputs[i * words + w]` holds models 64*w to 64*w+63 of variable i+1.
+// Every node visit processes a whole vector register worth of models (256 with
+// AVX2, 512 with AVX-512). The kernel is selected at runtime from CPUID, with a
+// portable fallback working on 8 words at a time.
+enum class Wide_Kernel { SCALAR, AVX2, AVX512 };
+
+// best kernel supported by the running CPU
+Wide_Kernel detect_wide_kernel();
+bool wide_kernel_supported(Wide_Kernel kernel);
+const char *wide_kernel_name(Wide_Kernel kernel);
+
+// kernel used by evaluate_wide, defaults to detect_wide_kernel()
+Wide_Kernel wide_kernel();
+// overrides the kernel (e.g. to compare them), it must be supported
+void set_wide_kernel(Wide_Kernel kernel);
+
+// Returns `words` words, bit j of word w being the value in model 64*w+j.
+std::vector<uint64_t> evaluate_wide(const Logic_Node &f,
+                                    const std::vector<uint64_t> &inputs,
+                                    size_t words);
+
+#endif // WIDE_EVALUATION_HPP
@@ -0,0 +1,77 @@
+#include "workload_generator.hpp"
+#include "dag_file.hpp"
+#include "formula_printer.hpp"
+#include "logic_builder.hpp"
+#include "logic_node.hpp"
+#include "random.hpp"
+
+#include <cassert>
+#include <vector>
+
+std::shared_ptr<Formula> generate_workload(Logic_Builder &builder,
+                                           const Workload_Options &options) {
+  assert(options.depth >= 1 && options.gates >= options.depth);
+  assert(options.min_fan_in >= 2 && options.min_fan_in <= options.max_fan_in);
+  assert(options.variables >= 1);
+  Random random(options.seed);
+  const size_t depth = options.depth;
+  const size_t width = options.gates / depth;
+  // probabilities are compared with a 32-bit random number
+  const double sharing = options.sharing * 4294967296.0;
+
+  // built on first use, the negation of variable v at 2v - 1
+  std::vector<std::shared_ptr<Formula>> literals(2 * size_t(options.variables));
+  auto literal = [&]() -> const std::shared_ptr<Formula> & {
+    const int variable = random.pick_int(1, options.variables);
+    const bool negated = random.generate_bool();
+    std::shared_ptr<Formula> &node = literals[2 * size_t(variable) - 1 - negated];
+    if (!node)
+      node = builder.make_variable(negated ? -variable : variable);
+    return node;
+  };
+  auto arity = [&]() {
+    size_t n = options.min_fan_in;
+    if (options.fan_in == Fan_In_Distribution::UNIFORM)
+      return size_t(random.pick_int(int(n), int(options.max_fan_in)));
+    while (n < options.max_fan_in && random.generate_bool())
+      ++n;
+    return n;
+  };
+
+  // level l holds the gates [l * width, (l + 1) * width)
+  std::vector<std::shared_ptr<Formula>> gates;
+  gates.reserve(width * depth);
+  std::vector<std::shared_ptr<Formula>> children;
+  for (size_t level = 0; level < depth; ++level) {
+    for (size_t column = 0; column < width; ++column) {
+      children.clear();
+      const size_t n = arity();
+      children.push_back(level ? gates[(level - 1) * width + column] : literal());
+      while (children.size() < n) {
+        if (level && random.generate() < sharing) {
+          size_t below = 1;
+          while (below < level && random.generate_bool())
+            ++below;
+          const size_t other = size_t(random.pick_int(0, int(width) - 1));
+          children.push_back(gates[(level - below) * width + other]);
+        } else {
+          children.push_back(literal());
+        }
+      }
+      gates.push_back(random.generate_bool() ? builder.make_conjunction(children)
+                                             : builder.make_disjunction(children));
+    }
+  }
+  return builder.make_disjunction(
+      std::vector<std::shared_ptr<Formula>>(gates.end() - width, gates.end()));
+}
+
+void write_workload(std::ostream &out, const Workload_Options &options,
+                    Workload_Format format) {
+  Logic_Builder builder;
+  const std::shared_ptr<Formula> root = generate_workload(builder, options);
+  if (format == Workload_Format::BINARY)
+    write_dag(out, {root});
+  else
+    out << formula_text(*root) << '\n';
+}
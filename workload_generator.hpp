@@ -0,0 +1,66 @@
+#ifndef WORKLOAD_GENERATOR_HPP
+#define WORKLOAD_GENERATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+
+class Logic_Node;
+class Logic_Builder;
+typedef Logic_Node Formula;
+
+// Synthetic formula DAGs of a controlled shape, for stress tests and
+// benchmarks at the scale of production formulas
+//
+// The gates are laid out in `depth` levels of the same width. The gate in
+// column i of a level always has the gate of column i of the level below as
+// a child, so every gate is reachable from the top level and the columns are
+// chains of the full depth. Its other children are, with probability
+// `sharing`, a random gate of a lower level, which creates reconvergence, and
+// otherwise a random literal. The level of a shared child is the one below
+// with probability 1/2, two below with probability 1/4, and so on: most
+// reconvergence is local, as in circuits. Without sharing the DAG is a tree
+// over the literals. The root is the disjunction of the top level.
+//
+// AND and OR gates are equally likely. Each literal is built once and shared
+// by all its occurrences. The result only depends on the options, seed
+// included.
+
+enum class Fan_In_Distribution {
+  UNIFORM,   // every arity of [min_fan_in, max_fan_in] equally likely
+  GEOMETRIC, // each child beyond min_fan_in with probability 1/2: wide gates are rare
+};
+
+struct Workload_Options {
+  // gates to build, rounded down to a multiple of the depth
+  size_t gates = 1 << 16;
+  // number of gate levels, at most `gates`
+  size_t depth = 16;
+  // children per gate, the chain child included. min_fan_in is at least 2,
+  // the builder turns a gate of one child into the child.
+  size_t min_fan_in = 2;
+  size_t max_fan_in = 4;
+  Fan_In_Distribution fan_in = Fan_In_Distribution::UNIFORM;
+  // literals are drawn from x1 to x<variables> and their negations
+  int variables = 64;
+  // probability of a child other than the chain child to be a shared gate
+  double sharing = 0.2;
+  uint64_t seed = 42;
+};
+
+// Builds the workload through `builder`, hash-consed if the builder is
+std::shared_ptr<Formula> generate_workload(Logic_Builder &builder,
+                                           const Workload_Options &options);
+
+enum class Workload_Format {
+  BINARY, // write_dag, see dag_file.hpp
+  TEXT,   // print_formula with let-bindings, see formula_printer.hpp
+};
+
+// Generates the workload with a builder of its own and writes it to `out`.
+// The DAG is released once written.
+void write_workload(std::ostream &out, const Workload_Options &options,
+                    Workload_Format format);
+
+#endif // WORKLOAD_GENERATOR_HPP